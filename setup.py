@@ -9,6 +9,10 @@ setup(
     version='1.0',
     ext_modules=[
         Extension('minesweeper',
-                  ['src/minesweeper.c', 'src/minesweeper_module.c']),
+                  ['src/minesweeper.c', 'src/flood.c', 'src/scan.c',
+                   'src/serialize.c', 'src/stats.c', 'src/trace.c',
+                   'src/replay.c', 'src/solver.c', 'src/exact.c',
+                   'src/minesweeper_module.c'],
+                  libraries=['m', 'pthread']),
     ],
 )
@@ -0,0 +1,230 @@
+/***************************************************************************//**
+
+  @file         aiworker.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Running the AI on a background thread.
+
+  The frontends submit the board after every turn, and a worker thread works
+  out a hint for it while the player thinks.  The worker only ever sees a copy
+  of the visible board, so the game itself is never shared between threads.
+  Submitting a new board (or cancelling) makes any hint for an older board
+  stale; the solver is told to stop, and its answer is thrown away rather than
+  reported.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "minesweeper.h"
+
+/* Most time the solver may spend on one hint, in seconds. */
+#define MSW_AIWORKER_BUDGET 0.5
+
+struct msw_aiworker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* The latest board submitted, waiting for the worker to pick it up. */
+	unsigned char *pending; /* visible halves of the cells only */
+	int pendingsize;
+	int rows, columns, mines, flags;
+	uint64_t hash;
+	int have_pending;
+
+	/* Each submission or cancellation starts a new job. */
+	unsigned long job;
+	unsigned long done; /* the job the result belongs to */
+	struct msw_ai_move result;
+	int cancel; /* tells the solver its job is stale; accessed atomically */
+
+	void (*ready)(void *arg);
+	void *ready_arg;
+	int quit;
+};
+
+static void *msw_aiworker_run(void *arg)
+{
+	struct msw_aiworker *w = arg;
+	struct msw_ai_budget budget = {
+		.seconds = MSW_AIWORKER_BUDGET,
+		.cancel = &w->cancel,
+	};
+	struct msw_ai_move move;
+	unsigned long job;
+	unsigned char *cells;
+	msw snap;
+
+	msw_init(&snap, 1, 1, 0);
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (!w->have_pending && !w->quit)
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (w->quit)
+			break;
+
+		// Take the pending board, and hand back our old buffer to
+		// copy the next one into.
+		if (snap.rows != w->rows || snap.columns != w->columns) {
+			msw_destroy(&snap);
+			msw_init(&snap, w->rows, w->columns, w->mines);
+		}
+		cells = snap.cells;
+		snap.cells = w->pending;
+		w->pending = cells;
+		w->pendingsize = w->rows * w->columns;
+		snap.mines = w->mines;
+		snap.flags = w->flags;
+		snap.hash = w->hash;
+		w->have_pending = 0;
+		__atomic_store_n(&w->cancel, 0, __ATOMIC_RELAXED);
+		job = w->job;
+		pthread_mutex_unlock(&w->lock);
+
+		move = msw_ai_anytime(&snap, &budget, NULL);
+
+		pthread_mutex_lock(&w->lock);
+		if (job == w->job) {
+			w->result = move;
+			w->done = job;
+			pthread_cond_broadcast(&w->cond);
+			if (w->ready) {
+				pthread_mutex_unlock(&w->lock);
+				w->ready(w->ready_arg);
+				pthread_mutex_lock(&w->lock);
+			}
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+	msw_destroy(&snap);
+	return NULL;
+}
+
+/**
+ * @brief Start an AI worker thread.
+ * @param ready If not NULL, called (on the worker thread) whenever a hint for
+ * the latest board becomes available. The worker's lock isn't held, so it may
+ * call msw_aiworker_poll(); by then the hint may have been cancelled.
+ * @param arg Passed to ready.
+ */
+struct msw_aiworker *msw_aiworker_create(void (*ready)(void *arg), void *arg)
+{
+	struct msw_aiworker *w = calloc(1, sizeof(struct msw_aiworker));
+
+	if (w == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	w->done = w->job - 1; /* no result until the first submission */
+	w->ready = ready;
+	w->ready_arg = arg;
+	if (pthread_create(&w->thread, NULL, msw_aiworker_run, w) != 0) {
+		fprintf(stderr, "error: pthread_create() failed.\n");
+		exit(EXIT_FAILURE);
+	}
+	return w;
+}
+
+/**
+ * @brief Stop the worker thread and free it.
+ */
+void msw_aiworker_destroy(struct msw_aiworker *w)
+{
+	pthread_mutex_lock(&w->lock);
+	w->quit = 1;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->cond);
+	free(w->pending);
+	free(w);
+}
+
+/**
+ * @brief Start working out a hint for the game as it is now.
+ *
+ * Any hint for an earlier board is cancelled. Only the visible board is copied,
+ * so the game may be played on while the worker runs.
+ */
+void msw_aiworker_submit(struct msw_aiworker *w, msw *game)
+{
+	int i, ncells = game->rows * game->columns;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->pending == NULL || w->pendingsize != ncells) {
+		free(w->pending);
+		w->pendingsize = ncells;
+		w->pending = malloc(ncells);
+		if (w->pending == NULL) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < ncells; i++)
+		w->pending[i] = game->cells[i] & 0xF0;
+	w->rows = game->rows;
+	w->columns = game->columns;
+	w->mines = game->mines;
+	w->flags = game->flags;
+	w->hash = game->hash;
+	w->have_pending = 1;
+	w->job++;
+	__atomic_store_n(&w->cancel, 1, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/**
+ * @brief Throw away any hint in progress or ready, e.g. because a move was made.
+ */
+void msw_aiworker_cancel(struct msw_aiworker *w)
+{
+	pthread_mutex_lock(&w->lock);
+	w->have_pending = 0;
+	w->job++;
+	__atomic_store_n(&w->cancel, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/**
+ * @brief Get the hint for the last board submitted, if it is ready.
+ * @returns 1 if *move was set, 0 if the worker is still busy (or cancelled).
+ */
+int msw_aiworker_poll(struct msw_aiworker *w, struct msw_ai_move *move)
+{
+	int ready;
+
+	pthread_mutex_lock(&w->lock);
+	ready = w->done == w->job;
+	if (ready)
+		*move = w->result;
+	pthread_mutex_unlock(&w->lock);
+	return ready;
+}
+
+/**
+ * @brief Wait for the hint for the last board submitted.
+ *
+ * A board must have been submitted since the last cancellation.
+ */
+struct msw_ai_move msw_aiworker_wait(struct msw_aiworker *w)
+{
+	struct msw_ai_move move;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->done != w->job)
+		pthread_cond_wait(&w->cond, &w->lock);
+	move = w->result;
+	pthread_mutex_unlock(&w->lock);
+	return move;
+}
@@ -0,0 +1,395 @@
+/***************************************************************************//**
+
+  @file         analyze.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Difficulty of many boards at once.
+
+  Boards come either from a range of seeds or from a corpus file, and are
+  handed out to threads a chunk at a time.  Each thread keeps a histogram of
+  every metric, and the histograms are added up at the end, so the summary is
+  the same however many threads there are.
+
+  With a 3BV band, only boards inside it count, and the boards found can be
+  written out as a corpus.  Chunks are handed out in order and stop once enough
+  boards are found, so the boards kept (the first ones in the band) don't
+  depend on the threads either.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "minesweeper.h"
+
+/* Boards handed to a thread at a time. */
+#define MSW_ANALYZE_CHUNK 1024
+
+/* Boards tried for each one wanted in a 3BV band, before giving up. */
+#define MSW_ANALYZE_TRIES 1000
+
+#define MSW_ANALYZE_METRICS 3
+static const char *metric_names[MSW_ANALYZE_METRICS] = {
+	"3bv", "openings", "islands"
+};
+
+/* A board inside the band. */
+struct analyze_board {
+	uint64_t index;
+	struct msw_metrics metrics;
+};
+
+struct analyze {
+	int rows, columns, mines;
+	uint64_t seed;                    /* board i is from seed + i ... */
+	const struct msw_corpus *corpus;  /* ... or board i of this */
+	uint64_t total;                   /* boards there are to look at */
+	int lo, hi;                       /* 3BV band, if lo >= 0 */
+	uint64_t want;                    /* boards wanted in the band */
+
+	pthread_mutex_t lock;
+	uint64_t next;                    /* first board of the next chunk */
+	uint64_t found;                   /* boards in the band so far */
+};
+
+struct analyze_thread {
+	pthread_t thread;
+	struct analyze *a;
+	uint64_t *hist[MSW_ANALYZE_METRICS]; /* rows * columns + 1 each */
+	uint64_t boards;
+	struct analyze_board *band;
+	size_t nband, bandcap;
+};
+
+static void analyze_count(struct analyze_thread *t,
+                          const struct msw_metrics *m)
+{
+	t->hist[0][m->bbbv]++;
+	t->hist[1][m->openings]++;
+	t->hist[2][m->islands]++;
+	t->boards++;
+}
+
+static void analyze_keep(struct analyze_thread *t, uint64_t i,
+                         const struct msw_metrics *m)
+{
+	if (t->nband == t->bandcap) {
+		t->bandcap = t->bandcap ? t->bandcap * 2 : 64;
+		t->band = realloc(t->band, t->bandcap * sizeof(*t->band));
+		if (t->band == NULL) {
+			fprintf(stderr, "error: realloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	t->band[t->nband].index = i;
+	t->band[t->nband].metrics = *m;
+	t->nband++;
+}
+
+static void *analyze_run(void *arg)
+{
+	struct analyze_thread *t = arg;
+	struct analyze *a = t->a;
+	struct msw_metrics m;
+	uint64_t i, first, last, found;
+	msw game;
+
+	msw_init(&game, a->rows, a->columns, a->mines);
+	for (;;) {
+		pthread_mutex_lock(&a->lock);
+		if (a->next >= a->total ||
+		    (a->lo >= 0 && a->found >= a->want)) {
+			pthread_mutex_unlock(&a->lock);
+			break;
+		}
+		first = a->next;
+		last = a->total - first < MSW_ANALYZE_CHUNK ?
+		       a->total : first + MSW_ANALYZE_CHUNK;
+		a->next = last;
+		pthread_mutex_unlock(&a->lock);
+
+		found = 0;
+		for (i = first; i < last; i++) {
+			if (a->corpus) {
+				msw_corpus_load(a->corpus, i, &game, NULL);
+			} else {
+				msw_set_seed(&game, a->seed + i);
+				msw_new_grid(&game);
+			}
+			msw_metrics(&game, &m);
+			if (a->lo < 0) {
+				analyze_count(t, &m);
+			} else if (m.bbbv >= a->lo && m.bbbv <= a->hi) {
+				analyze_keep(t, i, &m);
+				found++;
+			}
+		}
+		if (found) {
+			pthread_mutex_lock(&a->lock);
+			a->found += found;
+			pthread_mutex_unlock(&a->lock);
+		}
+	}
+	msw_destroy(&game);
+	return NULL;
+}
+
+static int analyze_cmp_board(const void *a, const void *b)
+{
+	const struct analyze_board *x = a, *y = b;
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+/*
+ * The smallest value with at least a fraction p of the boards at or below it.
+ */
+static int analyze_percentile(const uint64_t *hist, int n, uint64_t boards,
+                              double p)
+{
+	uint64_t seen = 0;
+	int v;
+
+	for (v = 0; v < n; v++) {
+		seen += hist[v];
+		if (seen > 0 && seen >= p * boards)
+			return v;
+	}
+	return n - 1;
+}
+
+static void analyze_summary(const struct analyze_thread *sum, int n,
+                            int histogram)
+{
+	int k, v, min, max;
+	double mean;
+	uint64_t boards = sum->boards;
+
+	printf("%-10s %6s %6s %6s %6s %6s %9s\n", "metric", "min", "p10", "p50",
+	       "p90", "max", "mean");
+	for (k = 0; k < MSW_ANALYZE_METRICS; k++) {
+		min = n;
+		max = 0;
+		mean = 0;
+		for (v = 0; v < n; v++) {
+			if (sum->hist[k][v] == 0)
+				continue;
+			min = v < min ? v : min;
+			max = v;
+			mean += (double)v * sum->hist[k][v];
+		}
+		printf("%-10s %6d %6d %6d %6d %6d %9.3f\n", metric_names[k],
+		       min, analyze_percentile(sum->hist[k], n, boards, .1),
+		       analyze_percentile(sum->hist[k], n, boards, .5),
+		       analyze_percentile(sum->hist[k], n, boards, .9),
+		       max, mean / boards);
+	}
+	if (!histogram)
+		return;
+	printf("\n%-10s %12s\n", "3bv", "boards");
+	for (v = 0; v < n; v++)
+		if (sum->hist[0][v])
+			printf("%-10d %12llu\n", v,
+			       (unsigned long long)sum->hist[0][v]);
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-j THREADS] [-b MIN:MAX [-o FILE]] [-H] ROWS "
+	       "COLUMNS MINES COUNT [SEED]\n", name);
+	printf("       %s [-j THREADS] [-b MIN:MAX [-o FILE]] [-H] -c CORPUS\n",
+	       name);
+	printf("\tSummarize the 3BV, openings and islands of COUNT boards "
+	       "generated\n\tfrom SEED, SEED+1, ... or of every board in "
+	       "CORPUS.\n");
+	printf("\t-j: threads to work on (default: one per processor)\n");
+	printf("\t-b: only count boards with a 3BV from MIN to MAX; COUNT is "
+	       "how many\n\t    to find\n");
+	printf("\t-o: write the boards found in the band to a corpus FILE\n");
+	printf("\t-H: also print how many boards have each 3BV\n");
+}
+
+/**
+ * @brief Summarize the difficulty of many boards from the command line.
+ */
+int analyze_main(int argc, char **argv)
+{
+	struct analyze a = { .lo = -1, .hi = -1, .seed = 1 };
+	struct msw_corpus corpus;
+	struct analyze_thread *t, sum = { 0 };
+	struct analyze_board *band = NULL;
+	const char *corpus_path = NULL, *out = NULL;
+	uint64_t *seeds, count = 0, scanned, nband = 0, b;
+	int i, j, k, v, n, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	int histogram = 0, rv = EXIT_SUCCESS;
+	uint64_t start;
+	double elapsed;
+	msw game;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			nthreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc &&
+		           sscanf(argv[i + 1], "%d:%d", &a.lo, &a.hi) == 2 &&
+		           a.lo >= 0 && a.lo <= a.hi) {
+			i++;
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out = argv[++i];
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			corpus_path = argv[++i];
+		} else if (strcmp(argv[i], "-H") == 0) {
+			histogram = 1;
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((out && a.lo < 0) || (corpus_path && i != argc) ||
+	    (!corpus_path && argc - i != 4 && argc - i != 5)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (corpus_path) {
+		if (msw_corpus_open(&corpus, corpus_path) < 0)
+			return EXIT_FAILURE;
+		a.corpus = &corpus;
+		a.rows = corpus.rows;
+		a.columns = corpus.columns;
+		a.mines = corpus.mines;
+		a.total = corpus.count;
+		a.want = corpus.count;
+	} else {
+		a.rows = atoi(argv[i]);
+		a.columns = atoi(argv[i + 1]);
+		a.mines = atoi(argv[i + 2]);
+		count = strtoull(argv[i + 3], NULL, 10);
+		if (argc - i == 5)
+			a.seed = strtoull(argv[i + 4], NULL, 10);
+		if (a.rows <= 0 || a.columns <= 0 || a.rows > 0xFFFF ||
+		    a.columns > 0xFFFF ||
+		    (int64_t)a.rows * a.columns > 0x7FFFFFFF) {
+			fprintf(stderr, "error: bad grid size (%dx%d)\n", a.rows,
+			        a.columns);
+			return EXIT_FAILURE;
+		}
+		if (a.mines <= 0 || a.mines >= (int64_t)a.rows * a.columns) {
+			fprintf(stderr, "error: bad number of mines (%d)\n",
+			        a.mines);
+			return EXIT_FAILURE;
+		}
+		if (a.seed == 0) {
+			fprintf(stderr, "error: seed must be nonzero\n");
+			return EXIT_FAILURE;
+		}
+		a.want = count;
+		a.total = a.lo < 0 ? count : count * MSW_ANALYZE_TRIES;
+	}
+	n = a.rows * a.columns + 1;
+
+	t = msw_calloc(nthreads, sizeof(*t));
+	for (j = 0; j < nthreads; j++) {
+		t[j].a = &a;
+		for (k = 0; k < MSW_ANALYZE_METRICS; k++)
+			t[j].hist[k] = msw_calloc(n, sizeof(uint64_t));
+	}
+	for (k = 0; k < MSW_ANALYZE_METRICS; k++)
+		sum.hist[k] = msw_calloc(n, sizeof(uint64_t));
+	pthread_mutex_init(&a.lock, NULL);
+
+	start = msw_stats_clock();
+	for (j = 1; j < nthreads; j++) {
+		if (pthread_create(&t[j].thread, NULL, analyze_run, &t[j]) != 0) {
+			fprintf(stderr, "error: can't start a thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	analyze_run(&t[0]);
+	for (j = 1; j < nthreads; j++)
+		pthread_join(t[j].thread, NULL);
+	elapsed = (msw_stats_clock() - start) / 1e9;
+	scanned = a.next;
+
+	// Add up the threads' counts. Boards in the band are put back in order
+	// first, and only the first ones wanted are counted.
+	for (j = 0; j < nthreads; j++) {
+		for (k = 0; k < MSW_ANALYZE_METRICS; k++)
+			for (v = 0; v < n; v++)
+				sum.hist[k][v] += t[j].hist[k][v];
+		sum.boards += t[j].boards;
+		nband += t[j].nband;
+	}
+	if (a.lo >= 0) {
+		band = msw_calloc(nband, sizeof(*band));
+		nband = 0;
+		for (j = 0; j < nthreads; j++) {
+			memcpy(band + nband, t[j].band,
+			       t[j].nband * sizeof(*band));
+			nband += t[j].nband;
+		}
+		qsort(band, nband, sizeof(*band), analyze_cmp_board);
+		if (nband > a.want)
+			nband = a.want;
+		for (b = 0; b < nband; b++)
+			analyze_count(&sum, &band[b].metrics);
+	}
+
+	printf("%llu boards (%dx%d, %d mines) in %.3fs on %d threads: "
+	       "%.0f boards/s\n", (unsigned long long)scanned, a.rows,
+	       a.columns, a.mines, elapsed, nthreads, scanned / elapsed);
+	if (a.lo >= 0)
+		printf("%llu with a 3BV from %d to %d\n",
+		       (unsigned long long)nband, a.lo, a.hi);
+	if (sum.boards > 0)
+		analyze_summary(&sum, n, histogram);
+	if (a.lo >= 0 && nband < a.want && !a.corpus) {
+		fflush(stdout);
+		fprintf(stderr, "warning: only found %llu of %llu boards\n",
+		        (unsigned long long)nband, (unsigned long long)a.want);
+	}
+
+	if (out) {
+		// Boards are written by seed, which gives back the same mines
+		// for a corpus too: its boards were generated the same way.
+		seeds = msw_calloc(nband, sizeof(uint64_t));
+		msw_init(&game, a.rows, a.columns, a.mines);
+		for (b = 0; b < nband; b++) {
+			if (a.corpus) {
+				msw_corpus_load(a.corpus, band[b].index, &game,
+				                NULL);
+				seeds[b] = game.seed;
+			} else {
+				seeds[b] = a.seed + band[b].index;
+			}
+		}
+		msw_destroy(&game);
+		if (msw_corpus_write_seeds(out, a.rows, a.columns, a.mines,
+		                           seeds, nband) < 0)
+			rv = EXIT_FAILURE;
+		free(seeds);
+	}
+
+	pthread_mutex_destroy(&a.lock);
+	for (j = 0; j < nthreads; j++) {
+		for (k = 0; k < MSW_ANALYZE_METRICS; k++)
+			free(t[j].hist[k]);
+		free(t[j].band);
+	}
+	for (k = 0; k < MSW_ANALYZE_METRICS; k++)
+		free(sum.hist[k]);
+	free(t);
+	free(band);
+	if (a.corpus)
+		msw_corpus_close(&corpus);
+	return rv;
+}
@@ -0,0 +1,811 @@
+/***************************************************************************//**
+
+  @file         bench.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Microbenchmarks of the engine's hot paths.
+
+  Each benchmark times one engine call on boards of several sizes and
+  densities.  A sample is a batch of games, each set up from its own fixed
+  seed before the clock starts, then the call is timed across the whole batch
+  so that the clock's own cost is spread thin.  After a few warmup samples,
+  the samples are summarized (minimum, median, mean, standard deviation and
+  maximum, in nanoseconds per call) as a table, CSV or JSON.
+
+  The same seeds are used on every run, so two runs can be compared line by
+  line.
+
+  The scan, flood and ai benchmarks don't call the engine.  They copy a board
+  that is bigger than the caches into row-major, 8x8 blocked and Morton
+  (Z-order) layouts, and time the ways the engine walks neighborhoods: every
+  cell counting its neighboring mines, as numbering a grid does, a breadth
+  first flood from one cell, as a flood fill would, and every number on the
+  opened board counting its flagged and unknown neighbors, as the AI's first
+  stage does.  Each layout steps to neighbors as an engine built on it would,
+  by precomputed distances or, for Morton, by stepping dilated integers.  They
+  run only on the big boards, and the engine's benchmarks never do.  The big
+  boards are sparse enough that most of their cells are in one opening.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minesweeper.h"
+
+/* Defaults for the options. */
+#define BENCH_SAMPLES 20
+#define BENCH_WARMUP 3
+
+/* Cells' worth of games in a batch, and the most games in one. */
+#define BENCH_BATCH_CELLS (1 << 16)
+#define BENCH_BATCH_MAX 256
+
+struct bench_board {
+	const char *name;
+	int rows, columns, mines;
+	int big; /* only for the layout benchmarks */
+};
+
+static const struct bench_board boards[] = {
+	{ "beginner", 9, 9, 10, 0 },
+	{ "intermediate", 16, 16, 40, 0 },
+	{ "expert", 16, 30, 99, 0 },
+	{ "large-10%", 256, 256, 6554, 0 },
+	{ "large-20%", 256, 256, 13107, 0 },
+	{ "huge", 2048, 2048, 209715, 1 },
+	{ "giant", 4096, 4096, 838861, 1 },
+};
+#define NBOARDS ((int)(sizeof(boards) / sizeof(*boards)))
+
+/* A game ready for a benchmark, and the cell to act on. */
+struct bench_game {
+	msw game;
+	struct msw_loc loc;
+	char *cells; /* the grid in another layout, for the layout benchmarks */
+	char *vis;   /* and the visible board */
+	char *seen;
+	int *queue;
+	int *off; /* distances to neighbors (see neigh_rowmajor()) */
+};
+
+/*
+ * A benchmark sets up a game from a seed (returning 0 if the board is no good
+ * for it, so the next seed is tried), then the call it times.
+ */
+struct bench {
+	const char *name;
+	int (*setup)(struct bench_game *g, uint64_t seed);
+	int (*run)(struct bench_game *g);
+	int big; /* runs on the big boards, and only them */
+};
+
+/*
+ * Generate the game's grid from a seed, and find a clear cell to dig first,
+ * scanning from a point picked by the seed.
+ */
+static int bench_board(struct bench_game *g, uint64_t seed)
+{
+	int i, j, ncells = g->game.rows * g->game.columns;
+
+	msw_set_seed(&g->game, seed);
+	msw_new_grid(&g->game);
+	msw_reset(&g->game);
+	for (j = 0; j < ncells; j++) {
+		i = (seed + j) % ncells;
+		if (MSW_CELL_GRID(g->game.cells[i]) == MSW_CCLEAR) {
+			g->loc.row = i / g->game.columns;
+			g->loc.col = i % g->game.columns;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int bench_opened(struct bench_game *g, uint64_t seed)
+{
+	if (!bench_board(g, seed))
+		return 0;
+	msw_dig(&g->game, g->loc.row, g->loc.col);
+	msw_end_turn(&g->game);
+	return 1;
+}
+
+static int setup_generate(struct bench_game *g, uint64_t seed)
+{
+	if (!g->game.has_grid)
+		msw_new_grid(&g->game);
+	msw_set_seed(&g->game, seed);
+	return 1;
+}
+
+static int run_generate(struct bench_game *g)
+{
+	msw_new_grid(&g->game);
+	return 0;
+}
+
+static int run_dig(struct bench_game *g)
+{
+	return msw_dig(&g->game, g->loc.row, g->loc.col);
+}
+
+/*
+ * After the first dig, pick a number with a hidden safe neighbor, and flag
+ * the mines around it.
+ */
+static int setup_reveal(struct bench_game *g, uint64_t seed)
+{
+	msw *game = &g->game;
+	struct msw_loc loc, neigh;
+	int iter, safe;
+	char val;
+
+	if (!bench_opened(g, seed))
+		return 0;
+	for_each_row_col(game, loc)
+	{
+		val = msw_get_visible(game, loc);
+		if (val <= MSW_CLEAR || val > '8')
+			continue;
+		safe = 0;
+		for_each_neigh(game, neigh, &loc, iter)
+			safe |= msw_get_visible(game, neigh) == MSW_UNKNOWN &&
+			        msw_get_grid(game, neigh) != MSW_MINE;
+		if (!safe)
+			continue;
+		for_each_neigh(game, neigh, &loc, iter)
+			if (msw_get_grid(game, neigh) == MSW_MINE)
+				msw_flag(game, neigh.row, neigh.col);
+		msw_end_turn(game);
+		g->loc = loc;
+		return 1;
+	}
+	return 0;
+}
+
+static int run_reveal(struct bench_game *g)
+{
+	return msw_reveal(&g->game, g->loc.row, g->loc.col);
+}
+
+/*
+ * Uncover every safe cell. Only a won game makes msw_won() look at them all.
+ */
+static int setup_won(struct bench_game *g, uint64_t seed)
+{
+	int i, ncells = g->game.rows * g->game.columns;
+
+	if (!bench_board(g, seed))
+		return 0;
+	for (i = 0; i < ncells; i++)
+		if (MSW_CELL_VIS(g->game.cells[i]) == MSW_CUNKNOWN &&
+		    MSW_CELL_GRID(g->game.cells[i]) != MSW_CMINE)
+			msw_dig(&g->game, i / g->game.columns,
+			        i % g->game.columns);
+	return 1;
+}
+
+static int run_won(struct bench_game *g)
+{
+	return msw_won(&g->game);
+}
+
+static int setup_undo(struct bench_game *g, uint64_t seed)
+{
+	int ncells = g->game.rows * g->game.columns;
+
+	msw_enable_undo_logging(&g->game, ncells + 16);
+	return bench_opened(g, seed);
+}
+
+static int run_undo(struct bench_game *g)
+{
+	return msw_undo(&g->game);
+}
+
+static int run_ai(struct bench_game *g)
+{
+	return msw_ai(&g->game).action;
+}
+
+/*
+ * Offsets of a cell in each layout. Blocked boards have a multiple of 8 rows
+ * and columns, and Morton ones are squares with a power of two side, which all
+ * the big boards are. These are only used to copy a board in; the benchmarks
+ * step from a cell to its neighbors the way a real engine in that layout
+ * would.
+ */
+static inline int layout_rowmajor(int columns, int r, int c)
+{
+	return r * columns + c;
+}
+
+static inline int layout_blocked(int columns, int r, int c)
+{
+	return ((r >> 3) * (columns >> 3) + (c >> 3)) << 6 |
+	       (r & 7) << 3 | (c & 7);
+}
+
+static inline uint32_t morton_spread(uint32_t x)
+{
+	x = (x | x << 8) & 0x00FF00FF;
+	x = (x | x << 4) & 0x0F0F0F0F;
+	x = (x | x << 2) & 0x33333333;
+	return (x | x << 1) & 0x55555555;
+}
+
+static inline int layout_morton(int columns, int r, int c)
+{
+	(void)columns;
+	return morton_spread(c) | morton_spread(r) << 1;
+}
+
+/* The column and row bits of a Morton offset. */
+#define MORTON_X 0x55555555u
+#define MORTON_Y 0xAAAAAAAAu
+
+/*
+ * Which of a cell's neighbors (in rnbr/cnbr order) are on the board, given
+ * which of its edges it is on.
+ */
+static inline unsigned int bench_mask(int top, int bottom, int left, int right)
+{
+	unsigned int mask = 0xFF;
+
+	if (top)
+		mask &= ~0x07u;
+	if (bottom)
+		mask &= ~0xE0u;
+	if (left)
+		mask &= ~0x29u;
+	if (right)
+		mask &= ~0x94u;
+	return mask;
+}
+
+/*
+ * Each layout's neighbors of cell i at row r and column c: fill in their
+ * offsets (only those on the board are meaningful) and return which of them
+ * are on the board.
+ *
+ * Row-major neighbors are a fixed distance away. So are blocked ones, but the
+ * distance depends on where in its block the cell is, so there is a table of
+ * them for each of the 64 places. Morton neighbors are found by stepping the
+ * cell's column and row bits separately, as dilated integers: filling the gaps
+ * between the bits with ones lets a carry run through them.
+ */
+static inline unsigned int neigh_rowmajor(const struct bench_game *g, int i,
+                                          int r, int c, int *nb)
+{
+	int k;
+
+	for (k = 0; k < NUM_NEIGHBORS; k++)
+		nb[k] = i + g->off[k];
+	return bench_mask(r == 0, r == g->game.rows - 1, c == 0,
+	                  c == g->game.columns - 1);
+}
+
+static inline unsigned int neigh_blocked(const struct bench_game *g, int i,
+                                         int r, int c, int *nb)
+{
+	const int *off = g->off + (i & 63) * NUM_NEIGHBORS;
+	int k;
+
+	for (k = 0; k < NUM_NEIGHBORS; k++)
+		nb[k] = i + off[k];
+	return bench_mask(r == 0, r == g->game.rows - 1, c == 0,
+	                  c == g->game.columns - 1);
+}
+
+static inline unsigned int neigh_morton(const struct bench_game *g, int i,
+                                        int r, int c, int *nb)
+{
+	uint32_t x = i & MORTON_X, y = i & MORTON_Y;
+	uint32_t last = (uint32_t)g->game.rows * g->game.columns - 1;
+	uint32_t xs[3], ys[3];
+	int k;
+
+	(void)r;
+	(void)c;
+	xs[0] = (x - 1) & MORTON_X;
+	xs[1] = x;
+	xs[2] = ((x | MORTON_Y) + 1) & MORTON_X;
+	ys[0] = (y - 1) & MORTON_Y;
+	ys[1] = y;
+	ys[2] = ((y | MORTON_X) + 1) & MORTON_Y;
+	for (k = 0; k < NUM_NEIGHBORS; k++)
+		nb[k] = xs[cnbr[k] + 1] | ys[rnbr[k] + 1];
+	return bench_mask(y == 0, y == (last & MORTON_Y), x == 0,
+	                  x == (last & MORTON_X));
+}
+
+/*
+ * Visit every cell in the order it is stored in the layout, with its offset i,
+ * its neighbors' offsets nb and which of them are on the board, mask.
+ */
+#define BENCH_EACH_ROWMAJOR(g, i, mask, nb, BODY) do { \
+	int r_, c_; \
+	for (r_ = 0, i = 0; r_ < (g)->game.rows; r_++) \
+		for (c_ = 0; c_ < (g)->game.columns; c_++, i++) { \
+			mask = neigh_rowmajor(g, i, r_, c_, nb); \
+			BODY; \
+		} \
+} while (0)
+
+#define BENCH_EACH_BLOCKED(g, i, mask, nb, BODY) do { \
+	int r_, c_, p_; \
+	for (r_ = 0, i = 0; r_ < (g)->game.rows; r_ += 8) \
+		for (c_ = 0; c_ < (g)->game.columns; c_ += 8) \
+			for (p_ = 0; p_ < 64; p_++, i++) { \
+				mask = neigh_blocked(g, i, r_ + (p_ >> 3), \
+				                     c_ + (p_ & 7), nb); \
+				BODY; \
+			} \
+} while (0)
+
+#define BENCH_EACH_MORTON(g, i, mask, nb, BODY) do { \
+	int end_ = (g)->game.rows * (g)->game.columns; \
+	for (i = 0; i < end_; i++) { \
+		mask = neigh_morton(g, i, 0, 0, nb); \
+		BODY; \
+	} \
+} while (0)
+
+static int setup_layout(struct bench_game *g, uint64_t seed,
+                        int (*layout)(int columns, int r, int c), int opened)
+{
+	msw *game = &g->game;
+	size_t ncells = (size_t)game->rows * game->columns;
+	struct msw_loc loc;
+	int i, k, r, c;
+
+	if (!(opened ? bench_opened(g, seed) : bench_board(g, seed)))
+		return 0;
+	if (g->cells == NULL) {
+		g->cells = malloc(ncells);
+		g->vis = malloc(ncells);
+		g->seen = malloc(ncells);
+		g->queue = malloc(2 * ncells * sizeof(int));
+		g->off = malloc(64 * NUM_NEIGHBORS * sizeof(int));
+		if (!g->cells || !g->vis || !g->seen || !g->queue || !g->off) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for_each_row_col(game, loc) {
+		i = layout(game->columns, loc.row, loc.col);
+		g->cells[i] = msw_get_grid(game, loc);
+		g->vis[i] = msw_get_visible(game, loc);
+	}
+	// Distances to the neighbors from each place in a block (a block
+	// away from the top left corner, so that none are off the board).
+	for (i = 0; i < 64; i++) {
+		r = 8 + (i >> 3);
+		c = 8 + (i & 7);
+		for (k = 0; k < NUM_NEIGHBORS; k++)
+			g->off[i * NUM_NEIGHBORS + k] = layout(game->columns,
+				r + rnbr[k], c + cnbr[k]) -
+				layout(game->columns, r, c);
+	}
+	return 1;
+}
+
+/*
+ * Count every safe cell's neighboring mines, like numbering a grid.
+ */
+#define BENCH_SCAN(g, EACH) do { \
+	int i_, k_, nb_[NUM_NEIGHBORS], n_ = 0; \
+	unsigned int mask_; \
+	EACH(g, i_, mask_, nb_, { \
+		if ((g)->cells[i_] == MSW_MINE) \
+			continue; \
+		for (k_ = 0; k_ < NUM_NEIGHBORS; k_++) \
+			if (mask_ >> k_ & 1) \
+				n_ += (g)->cells[nb_[k_]] == MSW_MINE; \
+	}); \
+	return n_; \
+} while (0)
+
+/*
+ * Visit the opening around the first dig breadth first, like a flood fill.
+ * The queue holds each cell's offset, and its row and column (which only the
+ * edges of the board need).
+ */
+#define BENCH_FLOOD(g, LAYOUT, NEIGH) do { \
+	int C_ = (g)->game.columns, head_ = 0, tail_ = 0; \
+	int i_, k_, r_, c_, nb_[NUM_NEIGHBORS]; \
+	unsigned int mask_; \
+	memset((g)->seen, 0, (size_t)(g)->game.rows * C_); \
+	i_ = LAYOUT(C_, (g)->loc.row, (g)->loc.col); \
+	(g)->seen[i_] = 1; \
+	(g)->queue[tail_++] = i_; \
+	(g)->queue[tail_++] = (g)->loc.row << 16 | (g)->loc.col; \
+	while (head_ < tail_) { \
+		i_ = (g)->queue[head_++]; \
+		r_ = (g)->queue[head_] >> 16; \
+		c_ = (g)->queue[head_++] & 0xFFFF; \
+		if ((g)->cells[i_] != MSW_CLEAR) \
+			continue; \
+		mask_ = NEIGH(g, i_, r_, c_, nb_); \
+		for (k_ = 0; k_ < NUM_NEIGHBORS; k_++) { \
+			if (!(mask_ >> k_ & 1) || (g)->seen[nb_[k_]]) \
+				continue; \
+			(g)->seen[nb_[k_]] = 1; \
+			(g)->queue[tail_++] = nb_[k_]; \
+			(g)->queue[tail_++] = (r_ + rnbr[k_]) << 16 | \
+			                      (c_ + cnbr[k_]); \
+		} \
+	} \
+	return tail_ / 2; \
+} while (0)
+
+/*
+ * The AI's first stage over the board the first dig left: find every number
+ * whose unknown neighbors are all mines, or all safe.
+ */
+#define BENCH_AI(g, EACH) do { \
+	int i_, k_, nb_[NUM_NEIGHBORS], n_ = 0, flagged_, unknown_; \
+	unsigned int mask_; \
+	EACH(g, i_, mask_, nb_, { \
+		if ((g)->vis[i_] <= MSW_CLEAR || (g)->vis[i_] > '8') \
+			continue; \
+		flagged_ = unknown_ = 0; \
+		for (k_ = 0; k_ < NUM_NEIGHBORS; k_++) { \
+			if (!(mask_ >> k_ & 1)) \
+				continue; \
+			flagged_ += (g)->vis[nb_[k_]] == MSW_FLAG; \
+			unknown_ += (g)->vis[nb_[k_]] == MSW_UNKNOWN; \
+		} \
+		n_ += unknown_ > 0 && \
+		      ((g)->vis[i_] - MSW_CLEAR == flagged_ || \
+		       (g)->vis[i_] - MSW_CLEAR == flagged_ + unknown_); \
+	}); \
+	return n_; \
+} while (0)
+
+static int setup_rowmajor(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_rowmajor, 0);
+}
+
+static int setup_blocked(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_blocked, 0);
+}
+
+static int setup_morton(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_morton, 0);
+}
+
+static int setup_opened_rowmajor(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_rowmajor, 1);
+}
+
+static int setup_opened_blocked(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_blocked, 1);
+}
+
+static int setup_opened_morton(struct bench_game *g, uint64_t seed)
+{
+	return setup_layout(g, seed, layout_morton, 1);
+}
+
+static int run_scan_rowmajor(struct bench_game *g)
+{
+	BENCH_SCAN(g, BENCH_EACH_ROWMAJOR);
+}
+
+static int run_scan_blocked(struct bench_game *g)
+{
+	BENCH_SCAN(g, BENCH_EACH_BLOCKED);
+}
+
+static int run_scan_morton(struct bench_game *g)
+{
+	BENCH_SCAN(g, BENCH_EACH_MORTON);
+}
+
+static int run_flood_rowmajor(struct bench_game *g)
+{
+	BENCH_FLOOD(g, layout_rowmajor, neigh_rowmajor);
+}
+
+static int run_flood_blocked(struct bench_game *g)
+{
+	BENCH_FLOOD(g, layout_blocked, neigh_blocked);
+}
+
+static int run_flood_morton(struct bench_game *g)
+{
+	BENCH_FLOOD(g, layout_morton, neigh_morton);
+}
+
+static int run_ai_rowmajor(struct bench_game *g)
+{
+	BENCH_AI(g, BENCH_EACH_ROWMAJOR);
+}
+
+static int run_ai_blocked(struct bench_game *g)
+{
+	BENCH_AI(g, BENCH_EACH_BLOCKED);
+}
+
+static int run_ai_morton(struct bench_game *g)
+{
+	BENCH_AI(g, BENCH_EACH_MORTON);
+}
+
+static const struct bench benches[] = {
+	{ "generate", setup_generate, run_generate, 0 },
+	{ "dig", bench_board, run_dig, 0 },
+	{ "reveal", setup_reveal, run_reveal, 0 },
+	{ "won", setup_won, run_won, 0 },
+	{ "undo", setup_undo, run_undo, 0 },
+	{ "ai", bench_opened, run_ai, 0 },
+	{ "scan-rowmajor", setup_rowmajor, run_scan_rowmajor, 1 },
+	{ "scan-blocked", setup_blocked, run_scan_blocked, 1 },
+	{ "scan-morton", setup_morton, run_scan_morton, 1 },
+	{ "flood-rowmajor", setup_rowmajor, run_flood_rowmajor, 1 },
+	{ "flood-blocked", setup_blocked, run_flood_blocked, 1 },
+	{ "flood-morton", setup_morton, run_flood_morton, 1 },
+	{ "ai-rowmajor", setup_opened_rowmajor, run_ai_rowmajor, 1 },
+	{ "ai-blocked", setup_opened_blocked, run_ai_blocked, 1 },
+	{ "ai-morton", setup_opened_morton, run_ai_morton, 1 },
+};
+#define NBENCHES ((int)(sizeof(benches) / sizeof(*benches)))
+
+struct bench_result {
+	const struct bench *bench;
+	const struct bench_board *board;
+	int batch, samples;
+	double min, median, mean, stddev, max; /* nanoseconds per call */
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Run one benchmark on one board. Seeds are used in order from seed, skipping
+ * any the benchmark can't use.
+ */
+static void bench_run(const struct bench *b, const struct bench_board *board,
+                      int samples, int warmup, uint64_t seed, int generic,
+                      struct bench_result *res)
+{
+	int ncells = board->rows * board->columns;
+	int batch = BENCH_BATCH_CELLS / ncells, i, k;
+	struct bench_game *games;
+	double *times, sum = 0, sq = 0;
+	uint64_t start;
+	volatile int sink = 0;
+
+	if (batch < 1)
+		batch = 1;
+	if (batch > BENCH_BATCH_MAX)
+		batch = BENCH_BATCH_MAX;
+	games = calloc(batch, sizeof(*games));
+	times = calloc(samples, sizeof(double));
+	if (games == NULL || times == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = -warmup; i < samples; i++) {
+		for (k = 0; k < batch; k++) {
+			if (games[k].game.cells)
+				msw_destroy(&games[k].game);
+			msw_init(&games[k].game, board->rows, board->columns,
+			         board->mines);
+			msw_set_generic(&games[k].game, generic);
+			while (!b->setup(&games[k], seed++))
+				;
+		}
+		start = msw_stats_clock();
+		for (k = 0; k < batch; k++)
+			sink += b->run(&games[k]);
+		if (i >= 0)
+			times[i] = (double)(msw_stats_clock() - start) / batch;
+	}
+	(void)sink;
+	for (k = 0; k < batch; k++) {
+		msw_destroy(&games[k].game);
+		free(games[k].cells);
+		free(games[k].vis);
+		free(games[k].seen);
+		free(games[k].queue);
+		free(games[k].off);
+	}
+
+	res->bench = b;
+	res->board = board;
+	res->batch = batch;
+	res->samples = samples;
+	for (i = 0; i < samples; i++) {
+		sum += times[i];
+		sq += times[i] * times[i];
+	}
+	qsort(times, samples, sizeof(double), cmp_double);
+	res->min = times[0];
+	res->max = times[samples - 1];
+	res->median = samples % 2 ? times[samples / 2] :
+	              (times[samples / 2 - 1] + times[samples / 2]) / 2;
+	res->mean = sum / samples;
+	res->stddev = samples > 1 ?
+	              sqrt(fmax(sq - sum * sum / samples, 0) / (samples - 1)) :
+	              0;
+	free(times);
+	free(games);
+}
+
+static void print_text(FILE *f, const struct bench_result *r, int first)
+{
+	if (first)
+		fprintf(f, "%-14s %-14s %6s %12s %12s %12s %12s %12s\n",
+		        "benchmark", "board", "batch", "min ns", "median ns",
+		        "mean ns", "stddev ns", "max ns");
+	fprintf(f, "%-14s %-14s %6d %12.1f %12.1f %12.1f %12.1f %12.1f\n",
+	        r->bench->name, r->board->name, r->batch, r->min, r->median,
+	        r->mean, r->stddev, r->max);
+}
+
+static void print_csv(FILE *f, const struct bench_result *r, int first)
+{
+	if (first)
+		fprintf(f, "benchmark,board,rows,columns,mines,batch,samples,"
+		        "min_ns,median_ns,mean_ns,stddev_ns,max_ns\n");
+	fprintf(f, "%s,%s,%d,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+	        r->bench->name, r->board->name, r->board->rows,
+	        r->board->columns, r->board->mines, r->batch, r->samples,
+	        r->min, r->median, r->mean, r->stddev, r->max);
+}
+
+static void print_json(FILE *f, const struct bench_result *r, int first)
+{
+	fprintf(f, "%s\n    {\"benchmark\": \"%s\", \"board\": \"%s\", "
+	        "\"rows\": %d, \"columns\": %d, \"mines\": %d, \"batch\": %d, "
+	        "\"samples\": %d, \"min_ns\": %.1f, \"median_ns\": %.1f, "
+	        "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"max_ns\": %.1f}",
+	        first ? "" : ",", r->bench->name, r->board->name,
+	        r->board->rows, r->board->columns, r->board->mines, r->batch,
+	        r->samples, r->min, r->median, r->mean, r->stddev, r->max);
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-n SAMPLES] [-w WARMUP] [-s SEED] [-g] "
+	       "[-f text|csv|json] [-o FILE] [NAME]...\n", name);
+	printf("\tTime the engine's hot paths. NAME picks benchmarks "
+	       "(generate, dig,\n\treveal, won, undo, ai) or boards "
+	       "(beginner, intermediate, expert,\n\tlarge-10%%, large-20%%) "
+	       "to run; the default is all of them.\n");
+	printf("\tThe layout benchmarks (scan-rowmajor, scan-blocked, "
+	       "scan-morton,\n\tflood-rowmajor, flood-blocked, "
+	       "flood-morton, ai-rowmajor, ai-blocked,\n\tai-morton) only "
+	       "run on the big boards (huge, giant), and only when\n\tone "
+	       "of them is named.\n");
+	printf("\t-n: timed samples of each (default %d)\n", BENCH_SAMPLES);
+	printf("\t-w: untimed samples first (default %d)\n", BENCH_WARMUP);
+	printf("\t-s: first seed (default 1)\n");
+	printf("\t-g: use the generic engine, even on the standard boards\n");
+	printf("\t-f: output format (default text)\n");
+	printf("\t-o: write to FILE instead of standard output\n");
+}
+
+/*
+ * Whether a benchmark and board were picked by the names on the command line.
+ * Each of the two is picked if no name refers to its kind, except that the
+ * slow layout benchmarks only run when one of them or a big board is named.
+ */
+static int picked(char **names, int nnames, const struct bench *b,
+                  const struct bench_board *board)
+{
+	int i, j, bench_named = 0, board_named = 0, bench_ok = 0, board_ok = 0;
+
+	for (i = 0; i < nnames; i++) {
+		for (j = 0; j < NBENCHES; j++) {
+			if (strcmp(names[i], benches[j].name) == 0) {
+				bench_named = 1;
+				bench_ok |= &benches[j] == b;
+			}
+		}
+		for (j = 0; j < NBOARDS; j++) {
+			if (strcmp(names[i], boards[j].name) == 0) {
+				board_named = 1;
+				board_ok |= &boards[j] == board;
+			}
+		}
+	}
+	if (b->big != board->big)
+		return 0;
+	if (b->big && !bench_named && !board_named)
+		return 0;
+	return (!bench_named || bench_ok) && (!board_named || board_ok);
+}
+
+int main(int argc, char **argv)
+{
+	int samples = BENCH_SAMPLES, warmup = BENCH_WARMUP, i, j, n = 0;
+	int nnames, generic = 0;
+	char **names;
+	uint64_t seed = 1;
+	const char *format = "text", *path = NULL;
+	void (*print)(FILE *, const struct bench_result *, int);
+	struct bench_result res;
+	FILE *f = stdout;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			samples = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+			warmup = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-g") == 0) {
+			generic = 1;
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			format = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			path = argv[++i];
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	names = argv + i;
+	nnames = argc - i;
+	if (strcmp(format, "text") == 0) {
+		print = print_text;
+	} else if (strcmp(format, "csv") == 0) {
+		print = print_csv;
+	} else if (strcmp(format, "json") == 0) {
+		print = print_json;
+	} else {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (samples < 1 || warmup < 0 || seed == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (path && (f = fopen(path, "w")) == NULL) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+
+	if (print == print_json)
+		fprintf(f, "{\"samples\": %d, \"warmup\": %d, \"seed\": %llu, "
+		        "\"results\": [", samples, warmup,
+		        (unsigned long long)seed);
+	for (i = 0; i < NBENCHES; i++) {
+		for (j = 0; j < NBOARDS; j++) {
+			if (!picked(names, nnames, &benches[i], &boards[j]))
+				continue;
+			bench_run(&benches[i], &boards[j], samples, warmup,
+			          seed, generic, &res);
+			print(f, &res, n++ == 0);
+			fflush(f);
+		}
+	}
+	if (print == print_json)
+		fprintf(f, "\n]}\n");
+	if (f != stdout && fclose(f) != 0) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
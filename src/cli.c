@@ -18,6 +18,8 @@
 
 int msw_quit(msw *game) {
   printf("Aww. Play again soon!\n");
+  if (game->stats)
+    msw_stats_print(game->stats, stderr);
   msw_destroy(game);
   exit(EXIT_SUCCESS);
 }
@@ -42,13 +44,18 @@ void help() {
 /**
    @brief Run a whole game via CLI.
  */
-void run_game(int r, int c, int m)
+void run_game(int r, int c, int m, const char *record, int stats)
 {
   msw game;
   int status = MSW_MMOVE;
   char op;
 
   msw_init(&game, r, c, m);
+  msw_stats_enable(&game, stats);
+  if (record && msw_record(&game, record, 1) < 0) {
+    msw_destroy(&game);
+    return;
+  }
   cls();
   msw_print(&game, stdout);
   while (MSW_MOK(status)) {
@@ -84,12 +91,179 @@ void run_game(int r, int c, int m)
     }
   }
   printf("%s\n", MSW_MSG[status]);
+  if (stats)
+    msw_stats_print(game.stats, stderr);
   msw_destroy(&game);
 }
 
+/**
+   @brief Parse a non-negative integer, skipping leading blanks.
+   @returns Pointer past the number, or NULL if there wasn't one.
+ */
+static char *parse_int(char *p, int *out)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r')
+    p++;
+  if (*p < '0' || *p > '9')
+    return NULL;
+  *out = 0;
+  while (*p >= '0' && *p <= '9' && *out < 1000000)
+    *out = *out * 10 + (*p++ - '0');
+  return p;
+}
+
+/**
+   @brief Parse "ROW,COL" after a command.
+   @returns Pointer past the location, or NULL if it was malformed.
+ */
+static char *parse_loc(char *p, int *r, int *c)
+{
+  p = parse_int(p, r);
+  if (p == NULL)
+    return NULL;
+  while (*p == ' ' || *p == '\t' || *p == '\r')
+    p++;
+  if (*p++ != ',')
+    return NULL;
+  return parse_int(p, c);
+}
+
+/**
+   @brief Run one line of script commands.
+   @returns Status of the last command, or -1 if the script should stop.
+ */
+static int script_line(msw *game, char *p, FILE *out)
+{
+  int status = MSW_MMOVE, r, c;
+  char op;
+  struct msw_ai_move move;
+
+  for (;;) {
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+      p++;
+    if (*p == '\0')
+      return status;
+
+    op = *p++;
+    switch (op) {
+    case 'q': case 'Q':
+      return -1;
+    case 'p': case 'P':
+      msw_print(game, out);
+      continue;
+    case 'a': case 'A':
+      move = msw_ai(game);
+      status = msw_ai_apply(game, move);
+      fprintf(out, "%d %d,%d %s\n", status, move.loc.row, move.loc.col,
+              move.description);
+      break;
+    case 'd': case 'D':
+    case 'f': case 'F':
+    case 'u': case 'U':
+    case 'r': case 'R':
+      p = parse_loc(p, &r, &c);
+      if (p == NULL) {
+        fprintf(out, "%d %s\n", MSW_CMD, MSW_MSG[MSW_CMD]);
+        return MSW_CMD;
+      }
+      if (op == 'd' || op == 'D')
+        status = msw_dig(game, r, c);
+      else if (op == 'f' || op == 'F')
+        status = msw_flag(game, r, c);
+      else if (op == 'u' || op == 'U')
+        status = msw_unflag(game, r, c);
+      else
+        status = msw_reveal(game, r, c);
+      fprintf(out, "%d %s\n", status, MSW_MSG[status]);
+      break;
+    default:
+      fprintf(out, "%d %s\n", MSW_CMD, MSW_MSG[MSW_CMD]);
+      return MSW_CMD;
+    }
+
+    if (!MSW_MOK(status) || msw_won(game))
+      return -1;
+  }
+}
+
+/**
+   @brief Run a game from a stream of commands, without redrawing.
+
+   The same commands as the interactive game are accepted, plus 'p' to print
+   the board and 'a' to make the AI's move.  Each move is answered with a line
+   holding its status number and message.  The board is printed once the game
+   is over.  Input is read, and output written, in large blocks.
+ */
+static int run_script(FILE *in, int r, int c, int m, const char *record,
+                      int stats)
+{
+  msw game;
+  char *buf, *line, *nl;
+  size_t cap = 1 << 16, len = 0, n;
+  int done = 0;
+
+  msw_init(&game, r, c, m);
+  msw_stats_enable(&game, stats);
+  if (record && msw_record(&game, record, 0) < 0) {
+    msw_destroy(&game);
+    return EXIT_FAILURE;
+  }
+  setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+  buf = malloc(cap + 1);
+  if (buf == NULL) {
+    fprintf(stderr, "error: malloc() returned null.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  while (!done) {
+    n = fread(buf + len, 1, cap - len, in);
+    len += n;
+    buf[len] = '\0';
+
+    for (line = buf; !done && (nl = strchr(line, '\n')); line = nl + 1) {
+      *nl = '\0';
+      done = script_line(&game, line, stdout) < 0;
+    }
+
+    // Keep the partial line for the next block, growing if it's huge.
+    len -= line - buf;
+    memmove(buf, line, len);
+    buf[len] = '\0';
+    if (n == 0) {
+      // The last line might not end with a newline.
+      if (!done)
+        script_line(&game, buf, stdout);
+      done = 1;
+    } else if (len == cap) {
+      cap *= 2;
+      buf = realloc(buf, cap + 1);
+      if (buf == NULL) {
+        fprintf(stderr, "error: realloc() returned null.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  if (msw_won(&game))
+    printf("%d %s\n", MSW_MWIN, MSW_MSG[MSW_MWIN]);
+  msw_print(&game, stdout);
+  fflush(stdout);
+  if (stats)
+    msw_stats_print(game.stats, stderr);
+  free(buf);
+  msw_destroy(&game);
+  return EXIT_SUCCESS;
+}
+
 static void usage(char *name) {
-  printf("usage: %s [rows columns [mines]]\n", name);
+  printf("usage: %s [-r FILE] [-s FILE] [--stats] [--trace FILE] "
+         "[rows columns [mines]]\n", name);
   printf("\tPlay minesweeper.\n");
+  printf("\t-r FILE: record the game to FILE (see replay)\n");
+  printf("\t-s FILE: run commands from FILE (- for stdin) without redrawing\n");
+  printf("\t--stats: print engine counters and latencies at the end\n");
+  printf("\t--trace FILE: write a Chrome trace of the engine to FILE at the "
+         "end\n\t\t(needs a build with make TRACE=1)\n");
   help();
 }
 
@@ -98,7 +272,9 @@ static void usage(char *name) {
  */
 int cli_main(int argc, char *argv[])
 {
-  int r, c, m;
+  int r, c, m, n, rv, stats = 0;
+  char *record = NULL, *script = NULL, *trace = NULL;
+  FILE *in;
 
   // Show usage screen.
   if (argc >= 2 && strcmp(argv[1], "-h") == 0) {
@@ -106,6 +282,31 @@ int cli_main(int argc, char *argv[])
     return EXIT_SUCCESS;
   }
 
+  // Handle options.
+  while (argc >= 2 && argv[1][0] == '-') {
+    n = 2;
+    if (strcmp(argv[1], "--stats") == 0) {
+      stats = 1;
+      n = 1;
+    } else if (argc >= 3 && strcmp(argv[1], "-r") == 0) {
+      record = argv[2];
+    } else if (argc >= 3 && strcmp(argv[1], "-s") == 0) {
+      script = argv[2];
+    } else if (argc >= 3 && strcmp(argv[1], "--trace") == 0) {
+      trace = argv[2];
+    } else {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    argv[n] = argv[0];
+    argv += n;
+    argc -= n;
+  }
+
+  // The game may end with exit(), so dump the trace from there.
+  if (trace)
+    msw_trace_dump_at_exit(trace);
+
   // Set the grid size, if given.
   if (argc >= 3) {
     sscanf(argv[1], "%d", &r);
@@ -128,7 +329,19 @@ int cli_main(int argc, char *argv[])
     m = 20;
   }
 
-  run_game(r,c,m);
+  if (script) {
+    in = strcmp(script, "-") == 0 ? stdin : fopen(script, "r");
+    if (in == NULL) {
+      perror(script);
+      return EXIT_FAILURE;
+    }
+    rv = run_script(in, r, c, m, record, stats);
+    if (in != stdin)
+      fclose(in);
+    return rv;
+  }
+
+  run_game(r,c,m,record,stats);
 
   return 0;
 }
@@ -45,7 +45,7 @@ def main():
             help()
 
         if game.won():
-            status = msw.WON
+            status = msw.WIN
             break
 
     print(msw.get_message(status))
@@ -0,0 +1,300 @@
+/***************************************************************************//**
+
+  @file         corpus.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Memory-mappable corpus of boards.
+
+  A corpus file is a 64 byte header followed by fixed size board records, so
+  board i lives at offset 64 + i * stride and can be loaded straight out of the
+  mapping.  All integers are little endian.
+
+      header:  "MSWC" version:u32 rows:u32 columns:u32 mines:u32 stride:u32
+               count:u64 seed:u64 (zero padding to 64 bytes)
+      board:   seed:u64 start:u32 reserved:u32 mines:bitmap
+               (zero padding to stride, a multiple of 8)
+
+  The mine bitmap has one bit per cell in row-major order, least significant
+  bit first.  The start cell is the row-major index of a clear cell to make the
+  first dig on, or 0xFFFFFFFF if the board has none.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "encode.h"
+#include "minesweeper.h"
+
+#define MSW_CORPUS_MAGIC "MSWC"
+#define MSW_CORPUS_VERSION 1
+#define MSW_CORPUS_HEADER 64
+#define MSW_CORPUS_RECORD 16
+#define MSW_CORPUS_NOSTART 0xFFFFFFFFu
+
+static size_t corpus_stride(int rows, int columns)
+{
+	size_t bitmap = ((size_t)rows * columns + 7) / 8;
+	return (MSW_CORPUS_RECORD + bitmap + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Open a corpus file and map it into memory.
+ * @returns 0 on success, -1 on failure (with a message on stderr).
+ */
+int msw_corpus_open(struct msw_corpus *corpus, const char *path)
+{
+	struct stat st;
+	const unsigned char *hdr;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (st.st_size < MSW_CORPUS_HEADER) {
+		fprintf(stderr, "%s: not a board corpus\n", path);
+		close(fd);
+		return -1;
+	}
+
+	corpus->size = st.st_size;
+	corpus->base = mmap(NULL, corpus->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (corpus->base == MAP_FAILED) {
+		perror(path);
+		return -1;
+	}
+
+	hdr = corpus->base;
+	corpus->rows = msw_get_le32(hdr + 8);
+	corpus->columns = msw_get_le32(hdr + 12);
+	corpus->mines = msw_get_le32(hdr + 16);
+	corpus->stride = msw_get_le32(hdr + 20);
+	corpus->count = msw_get_le64(hdr + 24);
+	corpus->seed = msw_get_le64(hdr + 32);
+	if (memcmp(hdr, MSW_CORPUS_MAGIC, 4) != 0 ||
+	    msw_get_le32(hdr + 4) != MSW_CORPUS_VERSION || corpus->rows <= 0 ||
+	    corpus->columns <= 0 ||
+	    (int64_t)corpus->rows * corpus->columns > 0x7FFFFFFF ||
+	    corpus->mines < 0 ||
+	    corpus->mines >= (int64_t)corpus->rows * corpus->columns ||
+	    corpus->stride != corpus_stride(corpus->rows, corpus->columns) ||
+	    (corpus->size - MSW_CORPUS_HEADER) / corpus->stride < corpus->count) {
+		fprintf(stderr, "%s: bad or truncated board corpus\n", path);
+		msw_corpus_close(corpus);
+		return -1;
+	}
+	posix_madvise((void *)corpus->base, corpus->size,
+	              POSIX_MADV_SEQUENTIAL);
+	return 0;
+}
+
+/**
+ * @brief Unmap a corpus opened by msw_corpus_open().
+ */
+void msw_corpus_close(struct msw_corpus *corpus)
+{
+	munmap((void *)corpus->base, corpus->size);
+	corpus->base = NULL;
+}
+
+/**
+ * @brief Load a board from the corpus into a game.
+ * @param corpus The corpus.
+ * @param i Index of the board.
+ * @param game A game with the same geometry as the corpus. Its allocations are
+ * reused, so the same game may be loaded over and over.
+ * @param start If not NULL, receives a clear cell to start on (row -1 if the
+ * board has none).
+ * @returns 0 on success, -1 if the index or the game's geometry is wrong.
+ */
+int msw_corpus_load(const struct msw_corpus *corpus, uint64_t i, msw *game,
+                    struct msw_loc *start)
+{
+	const unsigned char *rec;
+	uint32_t cell;
+
+	if (i >= corpus->count || game->rows != corpus->rows ||
+	    game->columns != corpus->columns)
+		return -1;
+
+	rec = corpus->base + MSW_CORPUS_HEADER + i * corpus->stride;
+	game->mines = corpus->mines;
+	game->seed = msw_get_le64(rec);
+	msw_load_mines(game, rec + MSW_CORPUS_RECORD);
+	msw_reset(game);
+
+	if (start) {
+		cell = msw_get_le32(rec + 8);
+		if (cell == MSW_CORPUS_NOSTART) {
+			start->row = start->col = -1;
+		} else {
+			start->row = cell / game->columns;
+			start->col = cell % game->columns;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Find a clear cell to start on, scanning from a point picked by the seed so
+ * that starts don't all cluster in one corner.
+ */
+static uint32_t corpus_start(msw *game)
+{
+	int ncells = game->rows * game->columns;
+	int first = game->seed % ncells;
+	int i, cell;
+
+	for (i = 0; i < ncells; i++) {
+		cell = (first + i) % ncells;
+		if (MSW_CELL_GRID(game->cells[cell]) == MSW_CCLEAR)
+			return cell;
+	}
+	return MSW_CORPUS_NOSTART;
+}
+
+/*
+ * Write a corpus of boards generated from seeds[i], or from seed + i if seeds
+ * is NULL.
+ */
+static int corpus_write(const char *path, int rows, int columns, int mines,
+                        uint64_t seed, const uint64_t *seeds, uint64_t count)
+{
+	FILE *f;
+	msw game;
+	unsigned char *rec;
+	size_t stride = corpus_stride(rows, columns);
+	uint64_t i;
+	int cell, ncells = rows * columns;
+
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+	rec = calloc(stride > MSW_CORPUS_HEADER ? stride : MSW_CORPUS_HEADER, 1);
+	if (rec == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(rec, MSW_CORPUS_MAGIC, 4);
+	msw_put_le32(rec + 4, MSW_CORPUS_VERSION);
+	msw_put_le32(rec + 8, rows);
+	msw_put_le32(rec + 12, columns);
+	msw_put_le32(rec + 16, mines);
+	msw_put_le32(rec + 20, stride);
+	msw_put_le64(rec + 24, count);
+	msw_put_le64(rec + 32, seeds ? (count ? seeds[0] : 0) : seed);
+	fwrite(rec, 1, MSW_CORPUS_HEADER, f);
+
+	msw_init(&game, rows, columns, mines);
+	for (i = 0; i < count; i++) {
+		msw_set_seed(&game, seeds ? seeds[i] : seed + i);
+		msw_new_grid(&game);
+
+		memset(rec, 0, stride);
+		msw_put_le64(rec, game.seed);
+		msw_put_le32(rec + 8, corpus_start(&game));
+		for (cell = 0; cell < ncells; cell++)
+			if (MSW_CELL_GRID(game.cells[cell]) == MSW_CMINE)
+				rec[MSW_CORPUS_RECORD + cell / 8] |= 1 << (cell % 8);
+		fwrite(rec, 1, stride, f);
+	}
+	msw_destroy(&game);
+	free(rec);
+
+	if (fclose(f) != 0) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Generate a corpus file.
+ * @param path File to write.
+ * @param rows, columns, mines Geometry of every board.
+ * @param seed Board i is generated from seed + i.
+ * @param count Number of boards.
+ * @returns 0 on success, -1 on failure (with a message on stderr).
+ */
+int msw_corpus_write(const char *path, int rows, int columns, int mines,
+                     uint64_t seed, uint64_t count)
+{
+	return corpus_write(path, rows, columns, mines, seed, NULL, count);
+}
+
+/**
+ * @brief Write a corpus file of boards generated from a list of seeds.
+ * @param path File to write.
+ * @param rows, columns, mines Geometry of every board.
+ * @param seeds Board i is generated from seeds[i]. The header's seed is the
+ * first one.
+ * @param count Number of boards.
+ * @returns 0 on success, -1 on failure (with a message on stderr).
+ */
+int msw_corpus_write_seeds(const char *path, int rows, int columns, int mines,
+                           const uint64_t *seeds, uint64_t count)
+{
+	return corpus_write(path, rows, columns, mines, 0, seeds, count);
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s FILE ROWS COLUMNS MINES COUNT [SEED]\n", name);
+	printf("\tWrite COUNT boards, generated from SEED, SEED+1, ...\n");
+}
+
+/**
+ * @brief Generate a board corpus from the command line.
+ */
+int gen_corpus_main(int argc, char **argv)
+{
+	int r, c, m;
+	unsigned long long count, seed = 1;
+
+	if (argc < 6) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	r = atoi(argv[2]);
+	c = atoi(argv[3]);
+	m = atoi(argv[4]);
+	count = strtoull(argv[5], NULL, 10);
+	if (argc >= 7)
+		seed = strtoull(argv[6], NULL, 10);
+
+	if (r <= 0 || c <= 0 || r > 0xFFFF || c > 0xFFFF ||
+	    (int64_t)r * c > 0x7FFFFFFF) {
+		fprintf(stderr, "error: bad grid size (%dx%d)\n", r, c);
+		return EXIT_FAILURE;
+	}
+	if (m <= 0 || m >= (int64_t)r * c) {
+		fprintf(stderr, "error: bad number of mines (%d)\n", m);
+		return EXIT_FAILURE;
+	}
+	if (seed == 0) {
+		fprintf(stderr, "error: seed must be nonzero\n");
+		return EXIT_FAILURE;
+	}
+
+	if (msw_corpus_write(argv[1], r, c, m, seed, count) < 0)
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -1,15 +1,28 @@
 #include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
 #include "minesweeper.h"
 
+/* Width the message window gets when the terminal has room for it. */
+#define MESSAGES_WIDTH 60
+#define MESSAGES_MIN 20
+
+/* How often to check for a hint the player is waiting on, in milliseconds. */
+#define HINT_POLL 20
+
 struct msw_curses {
 	struct msw game;
 	WINDOW *board, *messages, *status;
-	unsigned int cur_row, cur_col;
+	int cur_row, cur_col;
 	struct msw_loc size;
+	struct msw_loc view;   // board cells the board window can show
+	struct msw_loc origin; // board cell at the top left of the window
+	struct msw_aiworker *worker; // works out the next hint in the background
+	int want_hint;               // the player asked for a hint not ready yet
 };
 
 enum msw_color {
-	MC_RED = 0,
+	MC_RED = 1, // pair 0 is reserved by curses
 	MC_ZERO,
 	MC_ONE,
 	MC_TWO,
@@ -21,40 +34,146 @@ enum msw_color {
 	MC_EIGHT,
 };
 
-static void draw_game(struct msw_curses *mc)
+static int min(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static int max(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/*
+ * Draw a single board cell, if it is inside the viewport.
+ */
+static void draw_cell(struct msw_curses *mc, int r, int c)
+{
+	int vr = r - mc->origin.row, vc = c - mc->origin.col;
+	char cell;
+	int toprint;
+
+	if (vr < 0 || vr >= mc->view.row || vc < 0 || vc >= mc->view.col)
+		return;
+
+	cell = msw_vcell(&mc->game, r, c);
+	switch (cell) {
+	case MSW_CLEAR:
+		toprint = ' ';
+		break;
+	case MSW_FLAG:
+		toprint = '*' | COLOR_PAIR(MC_RED);
+		break;
+	case MSW_UNKNOWN:
+		toprint = cell;
+		break;
+	case MSW_MINE:
+		toprint = '!' | COLOR_PAIR(MC_RED);
+		break;
+	default:
+		toprint = cell | COLOR_PAIR(MC_ZERO + (cell - '0'));
+		break;
+	}
+	if (r == mc->cur_row && c == mc->cur_col) {
+		toprint |= A_REVERSE;
+	}
+	mvwaddch(mc->board, vr + 1, vc + 1, toprint);
+}
+
+/*
+ * Redraw everything in the viewport. This costs the size of the window, not of
+ * the board, so it is only done when the view scrolls or the layout changes.
+ */
+static void draw_view(struct msw_curses *mc)
 {
+	werase(mc->board);
 	box(mc->board, 0, 0);
-	for (unsigned int r = 0; r < mc->game.rows; r++) {
-		for (unsigned int c = 0; c < mc->game.columns; c++) {
-			wmove(mc->board, r + 1, c + 1);
-			char cell = msw_vcell(&mc->game, r, c);
-			int toprint;
-			switch (cell) {
-			case MSW_CLEAR:
-				toprint = ' ';
-				break;
-			case MSW_FLAG:
-				toprint = '*' | COLOR_PAIR(MC_RED);
-				break;
-			case MSW_UNKNOWN:
-				toprint = cell;
-				break;
-			case MSW_MINE:
-				toprint = '!' | COLOR_PAIR(MC_RED);
-				break;
-			default:
-				toprint = cell | COLOR_PAIR(MC_ZERO + (cell - '0'));
-				break;
-			}
-			if (r == mc->cur_row && c == mc->cur_col) {
-				toprint |= A_REVERSE;
-			}
-			waddch(mc->board, toprint);
-		}
+	for (int r = 0; r < mc->view.row; r++)
+		for (int c = 0; c < mc->view.col; c++)
+			draw_cell(mc, mc->origin.row + r, mc->origin.col + c);
+}
+
+/*
+ * Redraw only the cells the last move changed.
+ */
+static void draw_changes(struct msw_curses *mc)
+{
+	const struct msw_change *changes;
+	int i, count;
+
+	changes = msw_changes(&mc->game, &count);
+	for (i = 0; i < count; i++)
+		draw_cell(mc, changes[i].loc.row, changes[i].loc.col);
+}
+
+static void draw_status(struct msw_curses *mc)
+{
+	werase(mc->status);
+	mvwprintw(mc->status, 0, 0, "Found: %d/%d", mc->game.flags,
+	          mc->game.mines);
+	if (mc->view.row < mc->game.rows || mc->view.col < mc->game.columns)
+		wprintw(mc->status, "  (%d,%d)", mc->cur_row, mc->cur_col);
+}
+
+/*
+ * Scroll the viewport so that the cursor is inside it, keeping a few cells of
+ * context where possible. Returns nonzero if the viewport moved.
+ */
+static int follow_cursor(struct msw_curses *mc)
+{
+	struct msw_loc old = mc->origin;
+	int margin_r = min(2, (mc->view.row - 1) / 2);
+	int margin_c = min(2, (mc->view.col - 1) / 2);
+
+	if (mc->cur_row < mc->origin.row + margin_r)
+		mc->origin.row = mc->cur_row - margin_r;
+	else if (mc->cur_row >= mc->origin.row + mc->view.row - margin_r)
+		mc->origin.row = mc->cur_row - mc->view.row + margin_r + 1;
+	if (mc->cur_col < mc->origin.col + margin_c)
+		mc->origin.col = mc->cur_col - margin_c;
+	else if (mc->cur_col >= mc->origin.col + mc->view.col - margin_c)
+		mc->origin.col = mc->cur_col - mc->view.col + margin_c + 1;
+
+	mc->origin.row = max(0, min(mc->origin.row, mc->game.rows - mc->view.row));
+	mc->origin.col = max(0, min(mc->origin.col, mc->game.columns - mc->view.col));
+	return old.row != mc->origin.row || old.col != mc->origin.col;
+}
+
+/*
+ * Size the windows to fit the terminal. Boards which don't fit are shown
+ * through a viewport which follows the cursor.
+ */
+static void layout(struct msw_curses *mc)
+{
+	int msgw;
+
+	getmaxyx(stdscr, mc->size.row, mc->size.col);
+
+	msgw = min(MESSAGES_WIDTH, mc->size.col - mc->game.columns - 2);
+	if (msgw < MESSAGES_MIN)
+		msgw = min(MESSAGES_MIN, mc->size.col / 3);
+	mc->view.row = max(1, min(mc->game.rows, mc->size.row - 3));
+	mc->view.col = max(1, min(mc->game.columns, mc->size.col - msgw - 2));
+	msgw = max(1, min(MESSAGES_WIDTH, mc->size.col - mc->view.col - 2));
+
+	if (mc->board) {
+		delwin(mc->board);
+		delwin(mc->messages);
+		delwin(mc->status);
 	}
+	// Create window as a good abstraction in case we add other components
+	mc->board = newwin(mc->view.row + 2, mc->view.col + 2, 0, 0);
+	mc->messages = newwin(mc->view.row + 2, msgw, 0, mc->view.col + 2);
+	scrollok(mc->messages, true);
+	mc->status = newwin(1, max(1, mc->size.col), mc->view.row + 2, 0);
+
+	follow_cursor(mc);
+	clear();
+	wnoutrefresh(stdscr);
+	draw_view(mc);
+	draw_status(mc);
 	wnoutrefresh(mc->board);
-	wmove(mc->status, 0, 0);
-	wprintw(mc->status, "Found: %d/%d", mc->game.flags, mc->game.mines);
+	wnoutrefresh(mc->messages);
 	wnoutrefresh(mc->status);
 }
 
@@ -62,6 +181,7 @@ static void init_game(struct msw_curses *mc, int rows, int cols, int mines)
 {
 	msw_init(&mc->game, rows, cols, mines);
 	msw_enable_undo_logging(&mc->game, 4096);
+	msw_track_changes(&mc->game, 1);
 
 	// NCURSES initialization:
 	initscr();            // initialize curses
@@ -81,17 +201,6 @@ static void init_game(struct msw_curses *mc, int rows, int cols, int mines)
 	getch();
 	timeout(-1);
 
-	getmaxyx(stdscr, mc->size.row, mc->size.col);
-
-	// Create window as a good abstraction in case we add other components
-	mc->board = newwin(rows + 2, cols + 2, 0, 0);
-	mc->cur_row = mc->cur_col = 0;
-
-	mc->messages = newwin(rows + 2, 60, 0, cols + 2);
-	scrollok(mc->messages, true);
-
-	mc->status = newwin(1, 80, rows + 2, 0);
-
 	init_pair(MC_RED, COLOR_RED, COLOR_BLACK);
 	init_pair(MC_ONE, COLOR_BLUE, COLOR_BLACK);
 	init_pair(MC_TWO, COLOR_GREEN, COLOR_BLACK);
@@ -102,13 +211,19 @@ static void init_game(struct msw_curses *mc, int rows, int cols, int mines)
 	init_pair(MC_SEVEN, COLOR_WHITE, COLOR_BLACK);
 	init_pair(MC_EIGHT, COLOR_WHITE, COLOR_BLACK);
 
-
-	draw_game(mc);
+	mc->board = mc->messages = mc->status = NULL;
+	mc->cur_row = mc->cur_col = 0;
+	mc->origin.row = mc->origin.col = 0;
+	mc->worker = msw_aiworker_create(NULL, NULL);
+	mc->want_hint = 0;
+	msw_aiworker_submit(mc->worker, &mc->game);
+	layout(mc);
 	doupdate();
 }
 
 static void destroy_game(struct msw_curses *mc)
 {
+	msw_aiworker_destroy(mc->worker);
 	wclear(mc->board);
 	endwin();
 	msw_destroy(&mc->game);
@@ -121,13 +236,50 @@ static void game_move(struct msw_curses *mc, int r, int c) {
 		mc->cur_col = c;
 }
 
+/*
+ * Give the player the hint they asked for, if the worker has it ready. Returns
+ * the status of the hint's move.
+ */
+static int give_hint(struct msw_curses *mc, int status)
+{
+	struct msw_ai_move move;
+
+	if (!msw_aiworker_poll(mc->worker, &move)) {
+		timeout(HINT_POLL); // check back soon
+		return status;
+	}
+	mc->want_hint = 0;
+	timeout(-1);
+	if (move.action != AI_NONE) {
+		mc->cur_row = move.loc.row;
+		mc->cur_col = move.loc.col;
+		status = msw_ai_apply(&mc->game, move);
+	}
+	wprintw(mc->messages, "%s\n", move.description);
+	wnoutrefresh(mc->messages);
+	return status;
+}
+
+/*
+ * Forget about a hint the player was waiting for, since they moved instead.
+ */
+static void drop_hint(struct msw_curses *mc)
+{
+	if (mc->want_hint) {
+		mc->want_hint = 0;
+		timeout(-1);
+	}
+}
+
 void game_loop(struct msw_curses *mc)
 {
 	int key;
 	int status = MSW_MMOVE;
-	struct msw_ai_move move;
+	int old_row, old_col, changed;
 
 	while (MSW_MOK(status) && (key = getch()) != 'q') {
+		old_row = mc->cur_row;
+		old_col = mc->cur_col;
 		switch (key) {
 		case 'h':
 			game_move(mc, mc->cur_row, mc->cur_col - 1);
@@ -142,54 +294,103 @@ void game_loop(struct msw_curses *mc)
 			game_move(mc, mc->cur_row, mc->cur_col + 1);
 			break;
 		case 'd':
+			drop_hint(mc);
 			status = msw_dig(&mc->game, mc->cur_row, mc->cur_col);
 			break;
 		case 'f':
+			drop_hint(mc);
 			status = msw_flag(&mc->game, mc->cur_row, mc->cur_col);
 			break;
 		case 'u':
+			drop_hint(mc);
 			status = msw_unflag(&mc->game, mc->cur_row, mc->cur_col);
 			break;
 		case 'r':
+			drop_hint(mc);
 			status = msw_reveal(&mc->game, mc->cur_row, mc->cur_col);
 			break;
 		case 'z':
+			drop_hint(mc);
 			status = msw_undo(&mc->game);
 			break;
 		case 'a':
-			move = msw_ai(&mc->game);
-			if (move.action == AI_REVEAL) {
-				mc->cur_row = move.loc.row;
-				mc->cur_col = move.loc.col;
-				status = msw_reveal(&mc->game, mc->cur_row, mc->cur_col);
-			} else if (move.action == AI_FLAG) {
-				mc->cur_row = move.loc.row;
-				mc->cur_col = move.loc.col;
-				status = msw_flag(&mc->game, mc->cur_row, mc->cur_col);
-			} else if (move.action == AI_DIG) {
-				mc->cur_row = move.loc.row;
-				mc->cur_col = move.loc.col;
-				status = msw_dig(&mc->game, mc->cur_row, mc->cur_col);
+			if (!mc->want_hint) {
+				mc->want_hint = 1;
+				wprintw(mc->messages, "Thinking...\n");
+				wnoutrefresh(mc->messages);
 			}
-			wprintw(mc->messages, "%s\n", move.description);
-			wnoutrefresh(mc->messages);
+			break;
+		case KEY_RESIZE:
+			layout(mc);
+			break;
 		default:
+			// including ERR, when we timed out waiting for a hint
 			break;
 		}
+		if (mc->want_hint)
+			status = give_hint(mc, status);
 		//printf("key: %c, r=%d c=%d\n", key, mc->cur_row, mc->cur_col);
-		draw_game(mc);
+		if (follow_cursor(mc)) {
+			draw_view(mc);
+		} else {
+			draw_changes(mc);
+			draw_cell(mc, old_row, old_col);
+			draw_cell(mc, mc->cur_row, mc->cur_col);
+		}
+		draw_status(mc);
+		wnoutrefresh(mc->board);
+		wnoutrefresh(mc->status);
 		doupdate();
+
+		// Once the board changes, start on the hint for the new one.
+		msw_changes(&mc->game, &changed);
 		msw_end_turn(&mc->game);
+		if (changed && MSW_MOK(status))
+			msw_aiworker_submit(mc->worker, &mc->game);
 	}
 }
 
+static void usage(char *name)
+{
+	printf("usage: %s [-r FILE] [rows columns [mines]]\n", name);
+	printf("\tPlay minesweeper.\n");
+	printf("\t-r FILE: record the game to FILE (see replay)\n");
+}
+
 int curses_main(int argc, char **argv)
 {
 	int rows = 16, cols = 30, mines = 99;
+	char *record = NULL;
 	struct msw_curses mc;
 
-	// TODO accept row/col/mine arg
+	if (argc >= 2 && strcmp(argv[1], "-h") == 0) {
+		usage(argv[0]);
+		return EXIT_SUCCESS;
+	}
+	if (argc >= 3 && strcmp(argv[1], "-r") == 0) {
+		record = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc >= 3) {
+		rows = atoi(argv[1]);
+		cols = atoi(argv[2]);
+		mines = argc >= 4 ? atoi(argv[3]) : rows * cols / 5;
+		if (rows <= 0 || cols <= 0 || rows > 0xFFFF || cols > 0xFFFF) {
+			fprintf(stderr, "error: bad grid size (%dx%d)\n", rows, cols);
+			return EXIT_FAILURE;
+		}
+		if (mines <= 0 || mines >= rows * cols) {
+			fprintf(stderr, "error: bad number of mines (%d)\n", mines);
+			return EXIT_FAILURE;
+		}
+	}
+
 	init_game(&mc, rows, cols, mines);
+	if (record && msw_record(&mc.game, record, 1) < 0) {
+		destroy_game(&mc);
+		return EXIT_FAILURE;
+	}
 	game_loop(&mc);
 	destroy_game(&mc);
 	return 0;
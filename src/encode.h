@@ -0,0 +1,96 @@
+/***************************************************************************//**
+
+  @file         encode.h
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Byte-level encoding helpers for the binary file formats.
+
+*******************************************************************************/
+
+#ifndef MSW_ENCODE_H
+#define MSW_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest possible encoding of a 64 bit varint. */
+#define MSW_VARINT_MAX 10
+
+static inline void msw_put_le32(unsigned char *p, uint32_t v)
+{
+	for (int i = 0; i < 4; i++)
+		p[i] = v >> (8 * i);
+}
+
+static inline void msw_put_le64(unsigned char *p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		p[i] = v >> (8 * i);
+}
+
+static inline uint32_t msw_get_le32(const unsigned char *p)
+{
+	uint32_t v = 0;
+	for (int i = 0; i < 4; i++)
+		v |= (uint32_t)p[i] << (8 * i);
+	return v;
+}
+
+static inline uint64_t msw_get_le64(const unsigned char *p)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++)
+		v |= (uint64_t)p[i] << (8 * i);
+	return v;
+}
+
+/*
+ * LEB128-style varints: seven bits per byte, least significant group first,
+ * high bit set on every byte but the last.
+ */
+static inline int msw_put_varint(unsigned char *p, uint64_t v)
+{
+	int n = 0;
+	while (v >= 0x80) {
+		p[n++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	p[n++] = v;
+	return n;
+}
+
+/*
+ * Decode a varint at *p, advancing *p past it. Sets *err (and returns 0) if the
+ * varint runs past end or is too long.
+ */
+static inline uint64_t msw_get_varint(const unsigned char **p,
+                                      const unsigned char *end, int *err)
+{
+	uint64_t v = 0;
+	const unsigned char *q = *p;
+	for (int shift = 0; shift < 64 && q < end; shift += 7) {
+		v |= (uint64_t)(*q & 0x7F) << shift;
+		if (!(*q++ & 0x80)) {
+			*p = q;
+			return v;
+		}
+	}
+	*err = 1;
+	return 0;
+}
+
+/* Map signed to unsigned so small magnitudes make short varints. */
+static inline uint64_t msw_zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t msw_unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+#endif /* MSW_ENCODE_H */
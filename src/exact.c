@@ -0,0 +1,1092 @@
+/***************************************************************************//**
+
+  @file         exact.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Exact chance of winning with best play, for small boards.
+
+  This is an expectimax over the player's digs.  A position is the visible
+  board, and every layout of mines consistent with it is equally likely, so the
+  layouts are listed once at the start and each dig splits them by what it
+  would reveal.  The value of a position is the best, over the cells to dig,
+  of the chance of each outcome times the value of the position it leads to.
+
+  Only the cells next to revealed ones are listed.  The rest are a pool whose
+  cells are interchangeable until a dig reveals one of their neighbors, so a
+  listed layout just says how many mines are in the pool, and stands for every
+  way of placing them.  A dig which reaches the pool takes the cells it
+  touches out of it, trying each one both ways.
+
+  What keeps this feasible:
+  - A cell which is safe in every layout is always worth digging, so no other
+    move is tried while there is one.
+  - Cells are tried safest first, and a cell is abandoned once it can no longer
+    beat the best so far (a dig wins at most as often as it is safe).
+  - Positions are remembered in a transposition table, keyed by a hash of the
+    revealed cells which is the same for every symmetry of the board.  The
+    table has a fixed size; when a bucket is full, the entry which took the
+    least work to find is evicted.
+
+  Threads share the table, and split the outcomes of each move at the top of
+  the search between them.
+
+  That is still not enough for a whole beginner board.  The time depends on how
+  many cells are left unknown.  Measured on one core with a two minute limit:
+  beginner boards (9x9, 10 mines) dug in the middle, which leaves 40 or 42
+  cells unknown, took under a tenth of a second.  An 8x8 board with 10 mines
+  and 40 unknown took 11 seconds.  With 45 unknown (7x7, 7 mines) or 54 (8x8,
+  10 mines) it ran out of time, and a beginner board dug in the corner, with
+  70 unknown, hadn't finished after 20 minutes.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minesweeper.h"
+
+/* Defaults for the options. */
+#define MSW_EXACT_MEMORY (64 << 20)
+#define MSW_EXACT_LAYOUTS (1L << 22)
+
+/* Entries per bucket of the table, and locks shared out among the buckets. */
+#define MSW_EXACT_WAYS 4
+#define MSW_EXACT_LOCKS 256
+
+/* Nodes between checks of the clock. */
+#define MSW_EXACT_CHECK 256
+
+/* The mines of one layout, a bit per cell. */
+struct msw_exact_mask {
+	uint64_t w[2];
+};
+
+/*
+ * A layout of the cells out of the pool, and how many mines the pool holds. It
+ * stands for choose[k][pool] layouts of the whole board, if k cells are left
+ * in the pool.
+ */
+struct msw_exact_layout {
+	struct msw_exact_mask mines;
+	int pool;
+};
+
+/* A position: the visible board, and the layouts consistent with it. */
+struct msw_exact_pos {
+	const char *vis;
+	int unknown;
+	struct msw_exact_mask pool;
+	int k; /* cells in the pool */
+	const struct msw_exact_layout *layouts;
+	long n;
+	double total; /* layouts of the whole board they stand for */
+};
+
+struct msw_exact_entry {
+	uint64_t key;
+	double win;
+	long work; /* nodes it took to find, or 0 if the entry is empty */
+};
+
+struct msw_exact {
+	int rows, columns, ncells, mines;
+	int nneigh[MSW_EXACT_MAX_CELLS];
+	int neigh[MSW_EXACT_MAX_CELLS][NUM_NEIGHBORS];
+	int nsym;
+	int sym[8][MSW_EXACT_MAX_CELLS];
+	uint64_t zobrist[MSW_EXACT_MAX_CELLS][9];
+	double choose[MSW_EXACT_MAX_CELLS + 1][MSW_EXACT_MAX_CELLS + 1];
+
+	struct msw_exact_entry *table;
+	size_t nbuckets; /* a power of two */
+	pthread_mutex_t locks[MSW_EXACT_LOCKS];
+
+	uint64_t deadline; /* msw_stats_clock() reading, 0 for none */
+	volatile int stopped;
+};
+
+struct msw_exact_thread {
+	struct msw_exact *e;
+	struct msw_exact_split *split;
+	pthread_t thread;
+	long nodes, hits, evictions;
+};
+
+/* One layout's outcome for a dig, for grouping. */
+struct msw_exact_outcome {
+	uint64_t key;
+	struct msw_exact_layout layout;
+	int k; /* cells left in the pool */
+};
+
+/* The outcomes of a move at the top of the search, shared by the threads. */
+struct msw_exact_split {
+	pthread_mutex_t lock;
+	const struct msw_exact_pos *pos;
+	int cell;
+	struct msw_exact_layout *layouts; /* where the cell is safe */
+	long *group;    /* start of each outcome, and the end */
+	double *weight; /* layouts each outcome stands for */
+	int ngroups, next;
+	double win;  /* from the outcomes finished */
+	double left; /* chance of the outcomes not finished */
+	double beat; /* the move is abandoned once it can't beat this */
+};
+
+static int msw_exact_test(const struct msw_exact_mask *m, int i)
+{
+	return (m->w[i >> 6] >> (i & 63)) & 1;
+}
+
+static void msw_exact_set(struct msw_exact_mask *m, int i)
+{
+	m->w[i >> 6] |= 1ULL << (i & 63);
+}
+
+static uint64_t msw_exact_mix(uint64_t z)
+{
+	z += 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Work out the neighbors, symmetries and hash keys of the board.
+ */
+static void msw_exact_setup(struct msw_exact *e, msw *game)
+{
+	struct msw_loc loc, neigh;
+	int r, c, i, d, s, iter, R, C;
+
+	e->rows = R = game->rows;
+	e->columns = C = game->columns;
+	e->ncells = R * C;
+	e->mines = game->mines;
+	for_each_row_col(game, loc)
+	{
+		i = msw_index(game, loc.row, loc.col);
+		for_each_neigh(game, neigh, &loc, iter)
+			e->neigh[i][e->nneigh[i]++] =
+				msw_index(game, neigh.row, neigh.col);
+		for (d = 0; d < 9; d++)
+			e->zobrist[i][d] = msw_exact_mix(i * 9 + d + 1);
+	}
+	for (i = 0; i <= e->ncells; i++) {
+		e->choose[i][0] = 1;
+		for (d = 1; d <= i; d++)
+			e->choose[i][d] = e->choose[i - 1][d - 1] +
+			                  e->choose[i - 1][d];
+	}
+
+	// Reflections, and on square boards the rotations and transposes too.
+	e->nsym = R == C ? 8 : 4;
+	for (s = 0; s < e->nsym; s++) {
+		for (r = 0; r < R; r++) {
+			for (c = 0; c < C; c++) {
+				int rr = s & 1 ? R - 1 - r : r;
+				int cc = s & 2 ? C - 1 - c : c;
+				e->sym[s][r * C + c] = s & 4 ? cc * C + rr
+				                             : rr * C + cc;
+			}
+		}
+	}
+}
+
+/*
+ * A key for the position which is the same for all its symmetries.
+ */
+static uint64_t msw_exact_key(const struct msw_exact *e, const char *vis)
+{
+	uint64_t key = 0, h;
+	int s, i;
+
+	for (s = 0; s < e->nsym; s++) {
+		h = 0;
+		for (i = 0; i < e->ncells; i++)
+			if (vis[i] != MSW_UNKNOWN)
+				h ^= e->zobrist[e->sym[s][i]][vis[i] - '0'];
+		if (s == 0 || h < key)
+			key = h;
+	}
+	return key;
+}
+
+static int msw_exact_lookup(struct msw_exact_thread *t, uint64_t key,
+                            double *win)
+{
+	struct msw_exact *e = t->e;
+	size_t b = key & (e->nbuckets - 1);
+	struct msw_exact_entry *entry = e->table + b * MSW_EXACT_WAYS;
+	int i, found = 0;
+
+	pthread_mutex_lock(&e->locks[b % MSW_EXACT_LOCKS]);
+	for (i = 0; i < MSW_EXACT_WAYS; i++) {
+		if (entry[i].work && entry[i].key == key) {
+			*win = entry[i].win;
+			found = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&e->locks[b % MSW_EXACT_LOCKS]);
+	t->hits += found;
+	return found;
+}
+
+static void msw_exact_store(struct msw_exact_thread *t, uint64_t key,
+                            double win, long work)
+{
+	struct msw_exact *e = t->e;
+	size_t b = key & (e->nbuckets - 1);
+	struct msw_exact_entry *entry = e->table + b * MSW_EXACT_WAYS;
+	int i, victim = 0;
+
+	pthread_mutex_lock(&e->locks[b % MSW_EXACT_LOCKS]);
+	for (i = 0; i < MSW_EXACT_WAYS; i++) {
+		if (entry[i].work == 0 || entry[i].key == key) {
+			victim = i;
+			break;
+		}
+		if (entry[i].work < entry[victim].work)
+			victim = i;
+	}
+	if (i == MSW_EXACT_WAYS) {
+		// Keep whichever took more work to find.
+		if (entry[victim].work > work)
+			victim = -1;
+		else
+			t->evictions++;
+	}
+	if (victim >= 0) {
+		entry[victim].key = key;
+		entry[victim].win = win;
+		entry[victim].work = work;
+	}
+	pthread_mutex_unlock(&e->locks[b % MSW_EXACT_LOCKS]);
+}
+
+static int msw_exact_timeout(struct msw_exact_thread *t)
+{
+	struct msw_exact *e = t->e;
+
+	if (e->stopped)
+		return 1;
+	if (!e->deadline || t->nodes % MSW_EXACT_CHECK)
+		return 0;
+	if (msw_stats_clock() >= e->deadline)
+		e->stopped = 1;
+	return e->stopped;
+}
+
+/*
+ * Dig a cell which is safe in a layout, flooding out from cells with no mines
+ * around them as the game does. Returns a key for what was revealed, and
+ * counts the cells in *count. If out isn't NULL, the numbers are written into
+ * it.
+ */
+static uint64_t msw_exact_reveal(const struct msw_exact *e, const char *vis,
+                                 char *out, const struct msw_exact_mask *l,
+                                 int cell, int *count)
+{
+	struct msw_exact_mask seen = { { 0, 0 } };
+	int stack[MSW_EXACT_MAX_CELLS];
+	int top = 0, i, n, c, d;
+	uint64_t key = 0;
+
+	stack[top++] = cell;
+	msw_exact_set(&seen, cell);
+	*count = 0;
+	while (top) {
+		c = stack[--top];
+		for (i = 0, d = 0; i < e->nneigh[c]; i++)
+			d += msw_exact_test(l, e->neigh[c][i]);
+		key ^= e->zobrist[c][d];
+		(*count)++;
+		if (out)
+			out[c] = '0' + d;
+		if (d)
+			continue;
+		for (i = 0; i < e->nneigh[c]; i++) {
+			n = e->neigh[c][i];
+			if (vis[n] == MSW_UNKNOWN && !msw_exact_test(&seen, n)) {
+				msw_exact_set(&seen, n);
+				stack[top++] = n;
+			}
+		}
+	}
+	return key;
+}
+
+/*
+ * Set up a position, finding its pool: the unknown cells with no revealed
+ * neighbors.
+ */
+static void msw_exact_position(const struct msw_exact *e,
+                               struct msw_exact_pos *pos, const char *vis,
+                               int unknown,
+                               const struct msw_exact_layout *layouts, long n)
+{
+	int c, j, front;
+	long i;
+
+	pos->vis = vis;
+	pos->unknown = unknown;
+	pos->layouts = layouts;
+	pos->n = n;
+	pos->pool.w[0] = pos->pool.w[1] = 0;
+	pos->k = 0;
+	for (c = 0; c < e->ncells; c++) {
+		if (vis[c] != MSW_UNKNOWN)
+			continue;
+		for (j = 0, front = 0; j < e->nneigh[c]; j++)
+			front |= vis[e->neigh[c][j]] != MSW_UNKNOWN;
+		if (!front) {
+			msw_exact_set(&pos->pool, c);
+			pos->k++;
+		}
+	}
+	pos->total = 0;
+	for (i = 0; i < n; i++)
+		pos->total += e->choose[pos->k][layouts[i].pool];
+}
+
+/* The outcomes of a dig, as they are found. */
+struct msw_exact_expand {
+	const struct msw_exact *e;
+	const char *vis;
+	struct msw_exact_outcome *out;
+	long n, cap;
+};
+
+/* One way a dig can go, part way through. */
+struct msw_exact_branch {
+	struct msw_exact_layout cur;
+	struct msw_exact_mask decided; /* cells out of the pool */
+	struct msw_exact_mask seen;
+	int k; /* cells left in the pool */
+	int stack[MSW_EXACT_MAX_CELLS], top;
+	uint64_t key;
+};
+
+/*
+ * Finish revealing the cells on a branch's stack, as msw_exact_reveal() does.
+ * Before a cell's number can be known, its neighbors in the pool are taken
+ * out of it, as a mine and as a safe cell, each on a branch of its own. Every
+ * branch's outcome is added to x.
+ */
+static void msw_exact_expand(struct msw_exact_expand *x,
+                             struct msw_exact_branch *b)
+{
+	const struct msw_exact *e = x->e;
+	struct msw_exact_branch t;
+	int c, i, n, d, mine;
+
+	while (b->top) {
+		c = b->stack[b->top - 1];
+		for (i = 0; i < e->nneigh[c]; i++) {
+			n = e->neigh[c][i];
+			if (msw_exact_test(&b->decided, n))
+				continue;
+			for (mine = 0; mine <= 1; mine++) {
+				if (mine ? b->cur.pool == 0 :
+				           b->cur.pool == b->k)
+					continue;
+				t = *b;
+				msw_exact_set(&t.decided, n);
+				t.k--;
+				if (mine) {
+					msw_exact_set(&t.cur.mines, n);
+					t.cur.pool--;
+				}
+				msw_exact_expand(x, &t);
+			}
+			return;
+		}
+		b->top--;
+		for (i = 0, d = 0; i < e->nneigh[c]; i++)
+			d += msw_exact_test(&b->cur.mines, e->neigh[c][i]);
+		b->key ^= e->zobrist[c][d];
+		if (d)
+			continue;
+		for (i = 0; i < e->nneigh[c]; i++) {
+			n = e->neigh[c][i];
+			if (x->vis[n] == MSW_UNKNOWN &&
+			    !msw_exact_test(&b->seen, n)) {
+				msw_exact_set(&b->seen, n);
+				b->stack[b->top++] = n;
+			}
+		}
+	}
+
+	if (x->n == x->cap) {
+		x->cap = x->cap ? x->cap * 2 : 64;
+		x->out = realloc(x->out, x->cap * sizeof(*x->out));
+		if (x->out == NULL) {
+			fprintf(stderr, "error: realloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	x->out[x->n].key = b->key;
+	x->out[x->n].layout = b->cur;
+	x->out[x->n++].k = b->k;
+}
+
+static int msw_exact_cmp_outcome(const void *a, const void *b)
+{
+	uint64_t x = ((const struct msw_exact_outcome *)a)->key;
+	uint64_t y = ((const struct msw_exact_outcome *)b)->key;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Group the ways digging a cell can go safely by what it reveals. Returns a
+ * new array of the layouts they leave, the start of each group (plus the end)
+ * in *group, and how many layouts of the board each group stands for in
+ * *weight.
+ */
+static struct msw_exact_layout *
+msw_exact_outcomes(const struct msw_exact *e, const struct msw_exact_pos *pos,
+                   int cell, long **group, double **weight, int *ngroups)
+{
+	struct msw_exact_expand x = { .e = e, .vis = pos->vis };
+	struct msw_exact_branch b;
+	struct msw_exact_layout *safe;
+	long i;
+
+	for (i = 0; i < pos->n; i++) {
+		b.cur = pos->layouts[i];
+		b.decided.w[0] = ~pos->pool.w[0];
+		b.decided.w[1] = ~pos->pool.w[1];
+		b.k = pos->k;
+		if (msw_exact_test(&pos->pool, cell)) {
+			if (b.cur.pool == pos->k)
+				continue;
+			msw_exact_set(&b.decided, cell);
+			b.k--;
+		} else if (msw_exact_test(&b.cur.mines, cell)) {
+			continue;
+		}
+		b.seen.w[0] = b.seen.w[1] = 0;
+		msw_exact_set(&b.seen, cell);
+		b.stack[0] = cell;
+		b.top = 1;
+		b.key = 0;
+		msw_exact_expand(&x, &b);
+	}
+	qsort(x.out, x.n, sizeof(*x.out), msw_exact_cmp_outcome);
+
+	safe = msw_calloc(x.n, sizeof(*safe));
+	*group = msw_calloc(x.n + 1, sizeof(long));
+	*weight = msw_calloc(x.n, sizeof(double));
+	*ngroups = 0;
+	for (i = 0; i < x.n; i++) {
+		safe[i] = x.out[i].layout;
+		if (i == 0 || x.out[i].key != x.out[i - 1].key)
+			(*group)[(*ngroups)++] = i;
+		(*weight)[*ngroups - 1] +=
+			e->choose[x.out[i].k][x.out[i].layout.pool];
+	}
+	(*group)[*ngroups] = x.n;
+	free(x.out);
+	return safe;
+}
+
+/*
+ * List the cells worth digging, safest first, with how many layouts of the
+ * board each is safe in. If any cell is safe in every layout, only it is
+ * listed.
+ */
+static int msw_exact_candidates(const struct msw_exact *e,
+                                const struct msw_exact_pos *pos, int *cand,
+                                double *safe)
+{
+	const struct msw_exact_layout *l = pos->layouts;
+	double mines[MSW_EXACT_MAX_CELLS] = { 0 };
+	double poolmines = 0, poolsafe = 0, w, m;
+	uint64_t bits;
+	long i;
+	int c, j, k = pos->k, ncand = 0;
+
+	for (i = 0; i < pos->n; i++) {
+		w = e->choose[k][l[i].pool];
+		for (j = 0; j < 2; j++) {
+			for (bits = l[i].mines.w[j]; bits; bits &= bits - 1)
+				mines[j * 64 + __builtin_ctzll(bits)] += w;
+		}
+		if (k) {
+			poolmines += w * l[i].pool / k;
+			poolsafe += w * (k - l[i].pool) / k;
+		}
+	}
+	for (c = 0; c < e->ncells; c++) {
+		if (pos->vis[c] != MSW_UNKNOWN)
+			continue;
+		if (msw_exact_test(&pos->pool, c)) {
+			m = poolmines;
+			safe[c] = poolsafe;
+		} else {
+			m = mines[c];
+			safe[c] = pos->total - mines[c];
+		}
+		if (safe[c] == 0)
+			continue;
+		if (m == 0) {
+			cand[0] = c;
+			return 1;
+		}
+		for (j = ncand++; j > 0 && safe[cand[j - 1]] < safe[c]; j--)
+			cand[j] = cand[j - 1];
+		cand[j] = c;
+	}
+	return ncand;
+}
+
+static double msw_exact_value(struct msw_exact_thread *t, const char *vis,
+                              int unknown,
+                              const struct msw_exact_layout *layouts, long n);
+
+/*
+ * The chance of winning by digging a cell, or some value no more than beat if
+ * it can't do better than that.
+ */
+static double msw_exact_dig(struct msw_exact_thread *t,
+                            const struct msw_exact_pos *pos, int cell,
+                            double beat)
+{
+	const struct msw_exact *e = t->e;
+	struct msw_exact_layout *safe;
+	char child[MSW_EXACT_MAX_CELLS];
+	double win = 0, left = 0, p, *weight;
+	long *group;
+	int g, ngroups, count;
+
+	safe = msw_exact_outcomes(e, pos, cell, &group, &weight, &ngroups);
+	for (g = 0; g < ngroups; g++)
+		left += weight[g] / pos->total;
+	for (g = 0; g < ngroups && win + left > beat && !e->stopped; g++) {
+		memcpy(child, pos->vis, e->ncells);
+		msw_exact_reveal(e, pos->vis, child, &safe[group[g]].mines,
+		                 cell, &count);
+		p = weight[g] / pos->total;
+		win += p * msw_exact_value(t, child, pos->unknown - count,
+		                           safe + group[g],
+		                           group[g + 1] - group[g]);
+		left -= p;
+	}
+	free(safe);
+	free(group);
+	free(weight);
+	return win;
+}
+
+/*
+ * The chance of winning from a position with best play.
+ */
+static double msw_exact_value(struct msw_exact_thread *t, const char *vis,
+                              int unknown,
+                              const struct msw_exact_layout *layouts, long n)
+{
+	struct msw_exact *e = t->e;
+	struct msw_exact_pos pos;
+	double safe[MSW_EXACT_MAX_CELLS];
+	int cand[MSW_EXACT_MAX_CELLS];
+	long start = t->nodes;
+	double best = 0, win;
+	uint64_t key;
+	int i, ncand;
+
+	if (unknown == e->mines)
+		return 1.0;
+	msw_exact_position(e, &pos, vis, unknown, layouts, n);
+	if (pos.total == 1)
+		return 1.0;
+	key = msw_exact_key(e, vis);
+	if (msw_exact_lookup(t, key, &win))
+		return win;
+	t->nodes++;
+	if (msw_exact_timeout(t))
+		return 0;
+
+	ncand = msw_exact_candidates(e, &pos, cand, safe);
+	for (i = 0; i < ncand && safe[cand[i]] / pos.total > best; i++) {
+		win = msw_exact_dig(t, &pos, cand[i], best);
+		if (win > best)
+			best = win;
+	}
+	if (!e->stopped)
+		msw_exact_store(t, key, best, t->nodes - start + 1);
+	return best;
+}
+
+/*
+ * Work through the outcomes of a move at the top of the search, alongside the
+ * other threads.
+ */
+static void *msw_exact_split_run(void *arg)
+{
+	struct msw_exact_thread *t = arg;
+	struct msw_exact_split *sp = t->split;
+	const struct msw_exact *e = t->e;
+	const struct msw_exact_pos *pos = sp->pos;
+	char child[MSW_EXACT_MAX_CELLS];
+	double p, win;
+	int g, count;
+
+	for (;;) {
+		pthread_mutex_lock(&sp->lock);
+		g = sp->next;
+		if (g == sp->ngroups || sp->win + sp->left <= sp->beat ||
+		    e->stopped) {
+			pthread_mutex_unlock(&sp->lock);
+			break;
+		}
+		sp->next++;
+		pthread_mutex_unlock(&sp->lock);
+
+		memcpy(child, pos->vis, e->ncells);
+		msw_exact_reveal(e, pos->vis, child,
+		                 &sp->layouts[sp->group[g]].mines, sp->cell,
+		                 &count);
+		p = sp->weight[g] / pos->total;
+		win = msw_exact_value(t, child, pos->unknown - count,
+		                      sp->layouts + sp->group[g],
+		                      sp->group[g + 1] - sp->group[g]);
+
+		pthread_mutex_lock(&sp->lock);
+		sp->win += p * win;
+		sp->left -= p;
+		pthread_mutex_unlock(&sp->lock);
+	}
+	return NULL;
+}
+
+/*
+ * msw_exact_dig() for the top of the search, on every thread.
+ */
+static double msw_exact_split_dig(struct msw_exact_thread *t, int nthreads,
+                                  const struct msw_exact_pos *pos, int cell,
+                                  double beat)
+{
+	struct msw_exact_split sp = { .pos = pos, .cell = cell, .beat = beat };
+	int i;
+
+	pthread_mutex_init(&sp.lock, NULL);
+	sp.layouts = msw_exact_outcomes(t->e, pos, cell, &sp.group, &sp.weight,
+	                                &sp.ngroups);
+	for (i = 0; i < sp.ngroups; i++)
+		sp.left += sp.weight[i] / pos->total;
+	for (i = 0; i < nthreads; i++)
+		t[i].split = &sp;
+	// The calling thread takes part too.
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&t[i].thread, NULL, msw_exact_split_run,
+		                   &t[i]) != 0)
+			t[i].split = NULL;
+	}
+	msw_exact_split_run(&t[0]);
+	for (i = 1; i < nthreads; i++)
+		if (t[i].split)
+			pthread_join(t[i].thread, NULL);
+	pthread_mutex_destroy(&sp.lock);
+	free(sp.layouts);
+	free(sp.group);
+	free(sp.weight);
+	return sp.win;
+}
+
+/* For listing the layouts consistent with the board. */
+struct msw_exact_list {
+	const struct msw_exact *e;
+	int nfront, nother;
+	int front[MSW_EXACT_MAX_CELLS];
+	int need[MSW_EXACT_MAX_CELLS], left[MSW_EXACT_MAX_CELLS];
+	struct msw_exact_mask cur;
+	struct msw_exact_layout *out;
+	long n, cap, max;
+};
+
+static void msw_exact_emit(struct msw_exact_list *l,
+                           const struct msw_exact_layout *m)
+{
+	if (l->n == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 1024;
+		l->out = realloc(l->out, l->cap * sizeof(*l->out));
+		if (l->out == NULL) {
+			fprintf(stderr, "error: realloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	l->out[l->n++] = *m;
+}
+
+/*
+ * Decide the frontier cells from the i'th on, with mines left to place.
+ */
+static void msw_exact_list_front(struct msw_exact_list *l, int i, int mines)
+{
+	const struct msw_exact *e = l->e;
+	int cell, mine, j, n, ok;
+
+	if (l->n > l->max)
+		return;
+	if (i == l->nfront) {
+		// The rest go in the pool.
+		if (mines <= l->nother) {
+			struct msw_exact_layout m = { l->cur, mines };
+			msw_exact_emit(l, &m);
+		}
+		return;
+	}
+	cell = l->front[i];
+	for (mine = 0; mine <= 1 && mine <= mines; mine++) {
+		ok = 1;
+		for (j = 0; j < e->nneigh[cell]; j++) {
+			n = e->neigh[cell][j];
+			if (l->left[n] < 0)
+				continue; /* not a number */
+			l->left[n]--;
+			l->need[n] -= mine;
+			if (l->need[n] < 0 || l->need[n] > l->left[n])
+				ok = 0;
+		}
+		if (mine)
+			msw_exact_set(&l->cur, cell);
+		if (ok)
+			msw_exact_list_front(l, i + 1, mines - mine);
+		l->cur.w[cell >> 6] &= ~(1ULL << (cell & 63));
+		for (j = 0; j < e->nneigh[cell]; j++) {
+			n = e->neigh[cell][j];
+			if (l->left[n] < 0)
+				continue;
+			l->left[n]++;
+			l->need[n] += mine;
+		}
+	}
+}
+
+/*
+ * List every layout of the cells next to revealed ones consistent with the
+ * board, with how many mines are left for the pool. Returns how many there
+ * are, or -1 if there are more than max.
+ */
+static long msw_exact_list(const struct msw_exact *e, const char *vis,
+                           long max, struct msw_exact_layout **out)
+{
+	struct msw_exact_list *l = msw_calloc(1, sizeof(*l));
+	int c, j, front;
+	long n;
+
+	l->e = e;
+	l->max = max;
+	for (c = 0; c < e->ncells; c++) {
+		l->left[c] = -1;
+		if (vis[c] == MSW_UNKNOWN)
+			continue;
+		l->need[c] = vis[c] - '0';
+		l->left[c] = 0;
+		for (j = 0; j < e->nneigh[c]; j++)
+			l->left[c] += vis[e->neigh[c][j]] == MSW_UNKNOWN;
+	}
+	for (c = 0; c < e->ncells; c++) {
+		if (vis[c] != MSW_UNKNOWN)
+			continue;
+		for (j = 0, front = 0; j < e->nneigh[c]; j++)
+			front |= vis[e->neigh[c][j]] != MSW_UNKNOWN;
+		if (front)
+			l->front[l->nfront++] = c;
+		else
+			l->nother++;
+	}
+	msw_exact_list_front(l, 0, e->mines);
+
+	n = l->n;
+	*out = l->out;
+	if (n > max) {
+		free(l->out);
+		*out = NULL;
+		n = -1;
+	}
+	free(l);
+	return n;
+}
+
+/**
+ * @brief Work out the chance of winning from here with best play.
+ * @param game The game, which must have at least one cell revealed and at most
+ * MSW_EXACT_MAX_CELLS cells. Flags are ignored.
+ * @param options Limits and settings (NULL for the defaults).
+ * @param report Receives the result.
+ * @returns 0 on success, or -1 if the board is unsuitable, the cells next to
+ * revealed ones have too many consistent layouts, or the time ran out.
+ *
+ * Every layout of mines consistent with the board is assumed equally likely,
+ * which is true of the grids made at the first dig.  The layout limit bounds
+ * only the start.  The search itself takes seconds with about 40 cells left
+ * unknown, but more than two minutes with 45 or more (see the top of
+ * exact.c), so set a time limit.
+ */
+int msw_exact(msw *game, const struct msw_exact_options *options,
+              struct msw_exact_report *report)
+{
+	static const struct msw_exact_options defaults = { 0 };
+	const struct msw_exact_options *opt = options ? options : &defaults;
+	struct msw_exact *e;
+	struct msw_exact_thread *t;
+	struct msw_exact_layout *layouts = NULL;
+	struct msw_exact_pos pos;
+	char vis[MSW_EXACT_MAX_CELLS];
+	double safe[MSW_EXACT_MAX_CELLS];
+	int cand[MSW_EXACT_MAX_CELLS];
+	int nthreads = opt->threads > 1 ? opt->threads : 1;
+	int i, ncand, unknown = 0, revealed = 0, best = -1, rv = -1;
+	size_t memory = opt->memory ? opt->memory : MSW_EXACT_MEMORY;
+	double win, bestwin = -1;
+	long n;
+
+	memset(report, 0, sizeof(*report));
+	report->best.row = report->best.col = -1;
+	if (game->rows * game->columns > MSW_EXACT_MAX_CELLS)
+		return -1;
+	for (i = 0; i < game->rows * game->columns; i++) {
+		vis[i] = msw_chars[MSW_CELL_VIS(game->cells[i])];
+		if (vis[i] == MSW_MINE)
+			return -1;
+		if (vis[i] == MSW_FLAG)
+			vis[i] = MSW_UNKNOWN;
+		unknown += vis[i] == MSW_UNKNOWN;
+	}
+	revealed = game->rows * game->columns - unknown;
+	if (revealed == 0)
+		return -1;
+
+	e = msw_calloc(1, sizeof(*e));
+	msw_exact_setup(e, game);
+	n = msw_exact_list(e, vis, opt->layouts > 0 ? opt->layouts
+	                                             : MSW_EXACT_LAYOUTS,
+	                   &layouts);
+	report->layouts = n;
+	if (n <= 0) {
+		free(e);
+		return -1;
+	}
+	msw_exact_position(e, &pos, vis, unknown, layouts, n);
+
+	e->deadline = msw_stats_deadline(opt->seconds);
+	for (e->nbuckets = 1;
+	     e->nbuckets * 2 * MSW_EXACT_WAYS * sizeof(struct msw_exact_entry) <=
+	     memory;
+	     e->nbuckets *= 2)
+		;
+	e->table = msw_calloc(e->nbuckets * MSW_EXACT_WAYS,
+	                           sizeof(struct msw_exact_entry));
+	for (i = 0; i < MSW_EXACT_LOCKS; i++)
+		pthread_mutex_init(&e->locks[i], NULL);
+	t = msw_calloc(nthreads, sizeof(*t));
+	for (i = 0; i < nthreads; i++)
+		t[i].e = e;
+
+	if (unknown == e->mines) {
+		bestwin = 1.0; /* already won */
+	} else if (opt->first) {
+		best = msw_index(game, opt->first->row, opt->first->col);
+		bestwin = vis[best] == MSW_UNKNOWN ?
+		          msw_exact_split_dig(t, nthreads, &pos, best, -1) : 0;
+	} else {
+		ncand = msw_exact_candidates(e, &pos, cand, safe);
+		for (i = 0;
+		     i < ncand && safe[cand[i]] / pos.total > bestwin; i++) {
+			win = msw_exact_split_dig(t, nthreads, &pos, cand[i],
+			                          bestwin);
+			if (win > bestwin) {
+				bestwin = win;
+				best = cand[i];
+			}
+		}
+	}
+
+	if (!e->stopped) {
+		rv = 0;
+		report->win = bestwin;
+		if (best >= 0) {
+			report->best.row = best / e->columns;
+			report->best.col = best % e->columns;
+		}
+	}
+	for (i = 0; i < nthreads; i++) {
+		report->nodes += t[i].nodes;
+		report->hits += t[i].hits;
+		report->evictions += t[i].evictions;
+	}
+	for (i = 0; i < MSW_EXACT_LOCKS; i++)
+		pthread_mutex_destroy(&e->locks[i]);
+	free(t);
+	free(e->table);
+	free(layouts);
+	free(e);
+	return rv;
+}
+
+/*
+ * Print how the AI's dig compares with best play. Its flags are placed as it
+ * goes (flags don't change the exact search), on a copy of the game so that
+ * each AI starts from the same board.
+ */
+static void compare(msw *game, const struct msw_exact_options *opt,
+                    const char *who, const struct msw_ai_budget *budget,
+                    double best)
+{
+	struct msw_exact_options first = *opt;
+	struct msw_exact_report report;
+	struct msw_ai_move move = { .action = AI_NONE };
+	unsigned char *buf;
+	size_t n = msw_serialize(game, NULL, 0);
+	msw copy;
+	int i;
+
+	buf = msw_calloc(n, 1);
+	msw_serialize(game, buf, n);
+	if (msw_deserialize(&copy, buf, n) < 0) {
+		fprintf(stderr, "error: can't copy the game\n");
+		exit(EXIT_FAILURE);
+	}
+	free(buf);
+
+	for (i = 0; i <= copy.rows * copy.columns; i++) {
+		move = budget ? msw_ai_anytime(&copy, budget, NULL) :
+		       msw_ai(&copy);
+		if (move.action != AI_FLAG)
+			break;
+		msw_ai_apply(&copy, move);
+	}
+	first.first = &move.loc;
+	if (move.action == AI_REVEAL) {
+		// Only cells next to flags it is sure of, so nothing is lost.
+		printf("%s: %s: win %.6f\n", who, move.description, best);
+	} else if (move.action != AI_DIG) {
+		printf("%s: %s\n", who, move.description);
+	} else if (msw_exact(&copy, &first, &report) < 0) {
+		printf("%s: dig (%d, %d): out of time\n", who, move.loc.row,
+		       move.loc.col);
+	} else {
+		printf("%s: dig (%d, %d): win %.6f (%.6f below best)\n", who,
+		       move.loc.row, move.loc.col, report.win,
+		       best - report.win);
+	}
+	msw_destroy(&copy);
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-j THREADS] [-t SECONDS] [-m MB] [-l LAYOUTS] "
+	       "[--trace FILE] ROWS COLUMNS MINES SEED ROW COL [ROW COL]...\n",
+	       name);
+	printf("\tDig the given cells in a game from SEED, then work out the "
+	       "chance of\n\twinning with best play, and with the AI's "
+	       "moves.\n");
+	printf("\t-j: threads to search on\n");
+	printf("\t-t: give up after SECONDS\n");
+	printf("\t-m: megabytes for remembered positions\n");
+	printf("\t-l: give up if more than LAYOUTS layouts of the cells next "
+	       "to revealed\n\t\tones fit the board\n");
+	printf("\t--trace: write a Chrome trace of the engine to FILE at the "
+	       "end\n\t\t(needs a build with make TRACE=1)\n");
+}
+
+/**
+ * @brief Work out the best play for a position from the command line.
+ */
+int exact_main(int argc, char **argv)
+{
+	struct msw_exact_options opt = { 0 };
+	struct msw_exact_report report;
+	struct msw_ai_budget budget = { .seconds = 1 };
+	const char *trace = NULL;
+	uint64_t start;
+	double elapsed;
+	int i, r, c, m, status;
+	msw game;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			opt.threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			opt.seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			opt.memory = (size_t)atol(argv[++i]) << 20;
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			opt.layouts = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace = argv[++i];
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc - i < 6 || (argc - i) % 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (trace)
+		msw_trace_dump_at_exit(trace);
+	r = atoi(argv[i]);
+	c = atoi(argv[i + 1]);
+	m = atoi(argv[i + 2]);
+	if (r <= 0 || c <= 0 || r * c > MSW_EXACT_MAX_CELLS) {
+		fprintf(stderr, "error: bad grid size (%dx%d), at most %d cells\n",
+		        r, c, MSW_EXACT_MAX_CELLS);
+		return EXIT_FAILURE;
+	}
+	if (m <= 0 || m >= r * c) {
+		fprintf(stderr, "error: bad number of mines (%d)\n", m);
+		return EXIT_FAILURE;
+	}
+
+	msw_init(&game, r, c, m);
+	msw_set_seed(&game, strtoull(argv[i + 3], NULL, 10));
+	for (i += 4; i < argc; i += 2) {
+		r = atoi(argv[i]);
+		c = atoi(argv[i + 1]);
+		if (!msw_in_bounds(&game, r, c)) {
+			fprintf(stderr, "error: (%d, %d) is off the board\n", r, c);
+			msw_destroy(&game);
+			return EXIT_FAILURE;
+		}
+		status = msw_dig(&game, r, c);
+		if (status == MSW_MBOOM) {
+			fprintf(stderr, "error: (%d, %d) is a mine\n", r, c);
+			msw_destroy(&game);
+			return EXIT_FAILURE;
+		}
+	}
+	msw_print(&game, stdout);
+
+	start = msw_stats_clock();
+	if (msw_exact(&game, &opt, &report) < 0) {
+		if (report.layouts < 0)
+			fprintf(stderr, "error: too many layouts of mines\n");
+		else
+			fprintf(stderr, "error: out of time\n");
+		msw_destroy(&game);
+		return EXIT_FAILURE;
+	}
+	elapsed = (msw_stats_clock() - start) / 1e9;
+	printf("%ld layouts, %ld positions searched, %ld table hits, %ld "
+	       "evictions in %.3fs\n", report.layouts, report.nodes,
+	       report.hits, report.evictions, elapsed);
+	printf("best: dig (%d, %d): win %.6f\n", report.best.row,
+	       report.best.col, report.win);
+	if (report.best.row >= 0) {
+		compare(&game, &opt, "ai", NULL, report.win);
+		compare(&game, &opt, "anytime", &budget, report.win);
+	}
+	msw_destroy(&game);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/***************************************************************************//**
+
+  @file         flood.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Uncovering a giant opening on several threads.
+
+  On a big board with few mines, one dig can uncover millions of cells.  The
+  cells of each opening were listed when the grid was numbered, so the list is
+  split into one part per thread, and no two threads ever touch the same cell.
+  What has to come out exactly as a single thread would leave it is the undo
+  log, whose entries are in the order of the list.  So it takes two passes:
+  each thread counts the cells its part will change, and after adding up the
+  counts each one knows where its entries start, and changes its cells.
+
+  Reporting changes one at a time is inherently in order, so a game which
+  tracks them is always dug on one thread.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "minesweeper.h"
+
+/* Most threads to dig one opening on, and fewest cells for each of them. */
+#define MSW_FLOOD_THREADS 16
+#define MSW_FLOOD_MIN (1 << 15)
+
+struct msw_flood {
+	pthread_t thread;
+	int started;
+	msw *game;
+	const int *cell, *end; /* this thread's part of the opening */
+	long first;   /* changes made by the parts before this one */
+	long changed; /* changes made by this part */
+	long skip;    /* changes which the undo log wouldn't keep */
+	long unflagged; /* flags this part uncovered */
+	uint64_t hash;
+};
+
+/*
+ * Whether digging an opening changes one of its cells. A flagged number keeps
+ * its flag, but a flagged clear cell is uncovered anyway, as msw_dig() does.
+ */
+static inline int msw_flood_changes(unsigned char c)
+{
+	return MSW_CELL_VIS(c) != MSW_CELL_GRID(c) &&
+	       (MSW_CELL_VIS(c) != MSW_CFLAG || MSW_CELL_GRID(c) == MSW_CCLEAR);
+}
+
+static void *msw_flood_count(void *arg)
+{
+	struct msw_flood *f = arg;
+	const unsigned char *cells = f->game->cells;
+	const int *cell;
+	long n = 0;
+
+	for (cell = f->cell; cell < f->end; cell++)
+		n += msw_flood_changes(cells[*cell]);
+	f->changed = n;
+	return NULL;
+}
+
+static void *msw_flood_apply(void *arg)
+{
+	struct msw_flood *f = arg;
+	msw *game = f->game;
+	unsigned char *cells = game->cells;
+	struct msw_undo_entry *e;
+	const int *cell;
+	long k = f->first, slot = 0;
+	int vis, grid;
+
+	msw_trace_begin("flood", f->end - f->cell);
+	if (game->undo)
+		slot = (game->undoidx + k) % game->undocap;
+	for (cell = f->cell; cell < f->end; cell++) {
+		if (!msw_flood_changes(cells[*cell]))
+			continue;
+		vis = MSW_CELL_VIS(cells[*cell]);
+		grid = MSW_CELL_GRID(cells[*cell]);
+		if (vis == MSW_CFLAG)
+			f->unflagged++;
+		if (game->undo && k >= f->skip) {
+			e = &game->undo[slot];
+			e->gen = game->gen;
+			e->loc.row = *cell / game->columns;
+			e->loc.col = *cell % game->columns;
+			e->old = msw_chars[vis];
+			e->new = msw_chars[grid];
+		}
+		if (game->undo && ++slot == game->undocap)
+			slot = 0;
+		f->hash ^= msw_hash_cell(*cell, msw_chars[vis]) ^
+		           msw_hash_cell(*cell, msw_chars[grid]);
+		cells[*cell] = MSW_CELL(grid, grid);
+		k++;
+	}
+	msw_trace_end("flood");
+	return NULL;
+}
+
+/*
+ * Run each part on a thread of its own, the first on the calling thread.
+ */
+static void msw_flood_run(struct msw_flood *parts, int n,
+                          void *(*fn)(void *))
+{
+	int i;
+
+	for (i = 1; i < n; i++)
+		parts[i].started = pthread_create(&parts[i].thread, NULL, fn,
+		                                  &parts[i]) == 0;
+	fn(&parts[0]);
+	for (i = 1; i < n; i++) {
+		if (parts[i].started)
+			pthread_join(parts[i].thread, NULL);
+		else
+			fn(&parts[i]);
+	}
+}
+
+/**
+ * @brief Set how many threads may uncover a giant opening.
+ * @param game The game.
+ * @param threads At most this many threads (1 to always dig on the calling
+ * thread), or 0 for one per processor, which is the default.
+ */
+void msw_set_flood_threads(msw *game, int threads)
+{
+	game->flood_threads = threads;
+}
+
+/**
+ * @brief Uncover an opening's cells on several threads, if it is worth it.
+ * @param game The game.
+ * @param cell The first of the opening's cells (see msw_label_regions()).
+ * @param end One past the last of them.
+ * @returns The number of cells uncovered, or -1 if the opening should be dug
+ * on the calling thread: it is too small, there is only one processor, or the
+ * game tracks changes.
+ */
+long msw_flood(msw *game, const int *cell, const int *end)
+{
+	struct msw_flood parts[MSW_FLOOD_THREADS];
+	long size = end - cell, n = 0;
+	int nthreads = game->flood_threads, i;
+
+	if (size < 2 * MSW_FLOOD_MIN || game->changecap || game->on_change)
+		return -1;
+	if (nthreads == 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > size / MSW_FLOOD_MIN)
+		nthreads = size / MSW_FLOOD_MIN;
+	if (nthreads > MSW_FLOOD_THREADS)
+		nthreads = MSW_FLOOD_THREADS;
+	if (nthreads < 2)
+		return -1;
+
+	for (i = 0; i < nthreads; i++) {
+		parts[i].game = game;
+		parts[i].cell = cell + size * i / nthreads;
+		parts[i].end = cell + size * (i + 1) / nthreads;
+		parts[i].hash = 0;
+		parts[i].unflagged = 0;
+	}
+	msw_flood_run(parts, nthreads, msw_flood_count);
+	for (i = 0; i < nthreads; i++) {
+		parts[i].first = n;
+		n += parts[i].changed;
+	}
+	for (i = 0; i < nthreads; i++)
+		parts[i].skip = n - game->undocap;
+	msw_flood_run(parts, nthreads, msw_flood_apply);
+
+	for (i = 0; i < nthreads; i++) {
+		game->hash ^= parts[i].hash;
+		game->flags -= parts[i].unflagged;
+	}
+	if (game->undo) {
+		game->undoidx = (game->undoidx + n) % game->undocap;
+		game->undoend = game->undoidx;
+		if (game->stats)
+			game->stats->undo_entries += n;
+	}
+	return n;
+}
@@ -10,120 +10,199 @@
 
 *******************************************************************************/
 
-#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <gtk/gtk.h>
 
 #include "minesweeper.h"
 
+/*
+  Size of a cell on screen, in pixels.  Widgets can't be much larger than 32767
+  pixels, which limits how big a board the GUI will show.
+ */
+#define GUI_CELL 20
+#define GUI_MAX_CELLS 1000
+
+/*
+  Glyphs: revealed numbers 0-8, then unknown, flag, and mine.
+ */
+#define GUI_GUNKNOWN 9
+#define GUI_GFLAG 10
+#define GUI_GMINE 11
+#define GUI_NGLYPHS 12
+
 msw *game;
-GtkWidget **buttons;
+GtkWidget *board;
 GtkWidget *label;
+cairo_surface_t *glyphs[GUI_NGLYPHS];
+char *record;
+struct msw_aiworker *worker;
+int damaged;   // the last move changed the board
+int want_hint; // the player asked for a hint which isn't ready yet
 
 /**
-   @brief Encode a minsweeper location into a gpointer.
+   @brief Get the glyph index of a minesweeper character.
  */
-static gpointer gui_encode_location(unsigned short row, unsigned short col)
+static int gui_glyph_index(char c)
 {
-  uintptr_t p = row;
-  p = p << (sizeof(col) * 8);
-  p |= col;
-  return (gpointer)p;
+  switch (c) {
+  case MSW_UNKNOWN:
+    return GUI_GUNKNOWN;
+  case MSW_FLAG:
+    return GUI_GFLAG;
+  case MSW_MINE:
+    return GUI_GMINE;
+  default:
+    return c - '0';
+  }
 }
 
 /**
-   @brief Decode a minesweeper location from a gpointer into a pair of vars.
+   @brief Get the label associated with a glyph.
  */
-static void gui_decode_location(gpointer p, unsigned short *row, unsigned short *col)
+static char *gui_label(int glyph)
 {
-  uintptr_t mask = 0;
-  mask = 0xFFFF;
-  *col = (uintptr_t)p & mask;
-  *row = (uintptr_t)p >> (sizeof(*col) * 8);
+  static char *labels[GUI_NGLYPHS] = {
+    "", "1", "2", "3", "4", "5", "6", "7", "8", "", "F", "!"
+  };
+  return labels[glyph];
 }
 
 /**
-   @brief Get the label associated with a minesweeper character.
+   @brief Set the color a glyph's label is drawn in.
  */
-static char *gui_label(char c)
+static void gui_label_color(cairo_t *cr, int glyph)
 {
-  switch (c) {
-  case '0':
-    return "0";
-  case '1':
-    return "1";
-  case '2':
-    return "2";
-  case '3':
-    return "3";
-  case '4':
-    return "4";
-  case '5':
-    return "5";
-  case '6':
-    return "6";
-  case '7':
-    return "7";
-  case '8':
-    return "8";
-  case '#':
-    return "  ";
-  case '!':
-    return "!";
-  case 'F':
-    return "F";
-  default:
-    return "?";
+  static const double colors[GUI_NGLYPHS][3] = {
+    {0.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.5, 0.0}, {1.0, 0.0, 0.0},
+    {0.0, 0.0, 0.5}, {0.5, 0.0, 0.0}, {0.0, 0.5, 0.5}, {0.0, 0.0, 0.0},
+    {0.5, 0.5, 0.5}, {0.0, 0.0, 0.0}, {0.8, 0.0, 0.0}, {0.0, 0.0, 0.0},
+  };
+  cairo_set_source_rgb(cr, colors[glyph][0], colors[glyph][1],
+                       colors[glyph][2]);
+}
+
+/**
+   @brief Return the image of a cell, rendering it the first time it's needed.
+
+   Every cell showing the same thing looks the same, so drawing the board is
+   just copying one of a dozen small surfaces into each cell.
+ */
+static cairo_surface_t *gui_glyph(cairo_t *cr, char c)
+{
+  int glyph = gui_glyph_index(c);
+  cairo_text_extents_t ext;
+  cairo_t *g;
+  char *text;
+
+  if (glyphs[glyph])
+    return glyphs[glyph];
+
+  glyphs[glyph] = cairo_surface_create_similar(cairo_get_target(cr),
+                                               CAIRO_CONTENT_COLOR,
+                                               GUI_CELL, GUI_CELL);
+  g = cairo_create(glyphs[glyph]);
+
+  // Unopened cells are darker than opened ones.
+  if (glyph >= GUI_GUNKNOWN && glyph != GUI_GMINE)
+    cairo_set_source_rgb(g, 0.70, 0.70, 0.70);
+  else if (glyph == GUI_GMINE)
+    cairo_set_source_rgb(g, 1.0, 0.6, 0.6);
+  else
+    cairo_set_source_rgb(g, 0.92, 0.92, 0.92);
+  cairo_paint(g);
+  cairo_set_source_rgb(g, 0.5, 0.5, 0.5);
+  cairo_set_line_width(g, 1);
+  cairo_rectangle(g, 0.5, 0.5, GUI_CELL - 1, GUI_CELL - 1);
+  cairo_stroke(g);
+
+  text = gui_label(glyph);
+  if (text[0]) {
+    gui_label_color(g, glyph);
+    cairo_select_font_face(g, "Sans", CAIRO_FONT_SLANT_NORMAL,
+                           CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(g, GUI_CELL * 0.65);
+    cairo_text_extents(g, text, &ext);
+    cairo_move_to(g, (GUI_CELL - ext.width) / 2 - ext.x_bearing,
+                  (GUI_CELL - ext.height) / 2 - ext.y_bearing);
+    cairo_show_text(g, text);
   }
+  cairo_destroy(g);
+  return glyphs[glyph];
 }
 
 /**
-   @brief Draw the labels onto the buttons and the status.
+   @brief Free the glyph cache.
  */
-static void gui_draw(int status)
+static void gui_free_glyphs(void)
 {
-  int max = game->rows * game->columns;
   int i;
-  for (i = 0; i < max; i++) {
-    gtk_button_set_label((GtkButton*) buttons[i], gui_label(game->visible[i]));
+  for (i = 0; i < GUI_NGLYPHS; i++) {
+    if (glyphs[i])
+      cairo_surface_destroy(glyphs[i]);
+    glyphs[i] = NULL;
   }
-  gtk_label_set_text(GTK_LABEL(label), MSW_MSG[status]);
 }
 
 /**
-   @brief Handle a button click on the grid.
+   @brief Draw the part of the board which needs it.
+
+   GTK clips drawing to the damaged area, so only the cells which intersect it
+   are drawn.
  */
-static void gui_click(GtkWidget *widget, GdkEvent *event, gpointer data)
+static gboolean gui_draw_board(GtkWidget *widget, cairo_t *cr, gpointer data)
 {
-  unsigned short row, col;
-  GdkEventButton *evtBttn = (GdkEventButton*)event;
-  GtkWidget *dialog;
-  GtkWidget *window = gtk_widget_get_toplevel(widget);
-  int status;
-  gui_decode_location(data, &row, &col);
-
-  if (evtBttn->button == 1) {
-    // Left click = DIG.
-    status = msw_dig(game, row, col);
-  } else if (evtBttn->button == 2) {
-    // Middle click = REVEAL.
-    status = msw_reveal(game, row, col);
-  } else if (evtBttn->button == 3) {
-    // Right click = FLAG.
-    status = msw_flag(game, row, col);
-    if (status == MSW_MFLAGERR) {
-      // If flag failed, there must be a flag there already, so unflag.
-      status = msw_unflag(game, row, col);
-      if (status == MSW_MUNFLAGERR) {
-        // If that failed too, return the original error.
-        status = MSW_MFLAGERR;
-      }
+  GdkRectangle clip;
+  int r, c, rmin, rmax, cmin, cmax;
+
+  if (!gdk_cairo_get_clip_rectangle(cr, &clip))
+    return FALSE;
+  rmin = MAX(clip.y / GUI_CELL, 0);
+  cmin = MAX(clip.x / GUI_CELL, 0);
+  rmax = MIN((clip.y + clip.height - 1) / GUI_CELL, game->rows - 1);
+  cmax = MIN((clip.x + clip.width - 1) / GUI_CELL, game->columns - 1);
+
+  for (r = rmin; r <= rmax; r++) {
+    for (c = cmin; c <= cmax; c++) {
+      cairo_set_source_surface(cr, gui_glyph(cr, msw_vcell(game, r, c)),
+                               c * GUI_CELL, r * GUI_CELL);
+      cairo_rectangle(cr, c * GUI_CELL, r * GUI_CELL, GUI_CELL, GUI_CELL);
+      cairo_fill(cr);
     }
   }
+  return FALSE;
+}
 
-  // Draw the GUI after that.
-  gui_draw(status);
+/**
+   @brief Mark a cell for redrawing when the game changes it.
+ */
+static void gui_damage(msw *g, const struct msw_change *change, void *arg)
+{
+  gtk_widget_queue_draw_area(board, change->loc.col * GUI_CELL,
+                             change->loc.row * GUI_CELL, GUI_CELL, GUI_CELL);
+  damaged = 1;
+}
+
+/**
+   @brief Show the status of the last move.
+ */
+static void gui_status(int status)
+{
+  gtk_label_set_text(GTK_LABEL(label), MSW_MSG[status]);
+}
+
+/**
+   @brief Finish a move: start on the next hint, and handle win/loss cases.
+ */
+static void gui_moved(int status)
+{
+  GtkWidget *dialog;
+  GtkWidget *window = gtk_widget_get_toplevel(board);
+
+  // The changed cells have been queued for drawing already.
+  if (damaged && MSW_MOK(status) && !msw_won(game))
+    msw_aiworker_submit(worker, game);
+  damaged = 0;
 
   // Handle win/loss cases.
   if (msw_won(game)) {
@@ -145,6 +224,98 @@ static void gui_click(GtkWidget *widget, GdkEvent *event, gpointer data)
   }
 }
 
+/**
+   @brief Handle a button click on the board.
+ */
+static gboolean gui_click(GtkWidget *widget, GdkEventButton *event,
+                          gpointer data)
+{
+  int row, col, status;
+
+  // Find the cell which was clicked on (the button may have been released
+  // outside of the board).
+  if (event->x < 0 || event->y < 0)
+    return TRUE;
+  row = event->y / GUI_CELL;
+  col = event->x / GUI_CELL;
+  if (!msw_in_bounds(game, row, col))
+    return TRUE;
+
+  if (event->button == 1) {
+    // Left click = DIG.
+    status = msw_dig(game, row, col);
+  } else if (event->button == 2) {
+    // Middle click = REVEAL.
+    status = msw_reveal(game, row, col);
+  } else if (event->button == 3) {
+    // Right click = FLAG.
+    status = msw_flag(game, row, col);
+    if (status == MSW_MFLAGERR) {
+      // If flag failed, there must be a flag there already, so unflag.
+      status = msw_unflag(game, row, col);
+      if (status == MSW_MUNFLAGERR) {
+        // If that failed too, return the original error.
+        status = MSW_MFLAGERR;
+      }
+    }
+  } else {
+    return TRUE;
+  }
+
+  // The player moved instead of waiting for their hint.
+  want_hint = 0;
+  gui_status(status);
+  gui_moved(status);
+  return TRUE;
+}
+
+/**
+   @brief Play the hint the player asked for, if the worker has it ready.
+ */
+static void gui_give_hint(void)
+{
+  struct msw_ai_move move;
+  int status = MSW_MMOVE;
+
+  if (!msw_aiworker_poll(worker, &move)) {
+    gtk_label_set_text(GTK_LABEL(label), "Thinking...");
+    return;
+  }
+  want_hint = 0;
+  gtk_label_set_text(GTK_LABEL(label), move.description);
+  if (move.action != AI_NONE) {
+    status = msw_ai_apply(game, move);
+    gui_moved(status);
+  }
+}
+
+/**
+   @brief Handle a click on the hint button.
+ */
+static void gui_hint_clicked(GtkWidget *widget, gpointer data)
+{
+  want_hint = 1;
+  gui_give_hint();
+}
+
+/**
+   @brief Give a hint the player was waiting for (on the main thread).
+ */
+static gboolean gui_hint_idle(gpointer data)
+{
+  if (want_hint)
+    gui_give_hint();
+  return FALSE;
+}
+
+/**
+   @brief Called on the worker thread when a hint is ready.
+ */
+static void gui_hint_ready(void *arg)
+{
+  g_idle_add(gui_hint_idle, NULL);
+}
+
 /**
    @brief "Activate" the GUI.  Called by my GTK application.
  */
@@ -152,8 +323,9 @@ void gui_activate(GtkApplication *app, gpointer user_data)
 {
   GtkWidget *window;
   GtkWidget *grid;
-  GtkWidget *button;
-  int i, j, idx;
+  GtkWidget *scroll;
+  GtkWidget *box;
+  GtkWidget *hint;
 
   // Create a window.
   window = gtk_application_window_new(app);
@@ -164,25 +336,33 @@ void gui_activate(GtkApplication *app, gpointer user_data)
   grid = gtk_grid_new();
   gtk_container_add(GTK_CONTAINER(window), grid);
 
-  // Create the status label
+  // The whole board is one drawing area, scrolled if it is too big.
+  board = gtk_drawing_area_new();
+  gtk_widget_set_size_request(board, game->columns * GUI_CELL,
+                              game->rows * GUI_CELL);
+  gtk_widget_add_events(board, GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK);
+  g_signal_connect(board, "draw", G_CALLBACK(gui_draw_board), NULL);
+  g_signal_connect(board, "button-release-event", G_CALLBACK(gui_click), NULL);
+  msw_set_change_callback(game, gui_damage, NULL);
+
+  scroll = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_propagate_natural_width(GTK_SCROLLED_WINDOW(scroll), TRUE);
+  gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(scroll), TRUE);
+  gtk_scrolled_window_set_max_content_width(GTK_SCROLLED_WINDOW(scroll), 1000);
+  gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(scroll), 700);
+  gtk_widget_set_hexpand(scroll, TRUE);
+  gtk_widget_set_vexpand(scroll, TRUE);
+  gtk_container_add(GTK_CONTAINER(scroll), board);
+  gtk_grid_attach(GTK_GRID(grid), scroll, 0, 0, 1, 1);
+
+  // Create the status label, and a button to ask for hints.
+  box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
   label = gtk_label_new("Make a move.");
-
-  // Allocate space to store our buttons.
-  buttons = calloc(game->rows * game->columns, sizeof(GtkWidget*));
-
-  // Create a button for every cell in the game.
-  for (i = 0; i < game->rows; i++) {
-    for (j = 0; j < game->columns; j++) {
-      idx = msw_index(game, i, j);
-      button = gtk_button_new_with_label(" ");
-      g_signal_connect(button, "button-release-event", G_CALLBACK(gui_click),
-                       gui_encode_location(i, j));
-      gtk_grid_attach(GTK_GRID(grid), button, j, i, 1, 1);
-      buttons[idx] = button;
-    }
-  }
-  gtk_grid_attach(GTK_GRID(grid), label, 0, game->rows, game->columns, 1);
-  gui_draw(MSW_MMOVE);
+  gtk_box_pack_start(GTK_BOX(box), label, TRUE, TRUE, 0);
+  hint = gtk_button_new_with_label("Hint");
+  g_signal_connect(hint, "clicked", G_CALLBACK(gui_hint_clicked), NULL);
+  gtk_box_pack_end(GTK_BOX(box), hint, FALSE, FALSE, 0);
+  gtk_grid_attach(GTK_GRID(grid), box, 0, 1, 1, 1);
   gtk_widget_show_all(window);
 }
 
@@ -190,8 +370,9 @@ void gui_activate(GtkApplication *app, gpointer user_data)
    @brief Display usage about this program.
  */
 static void usage(char *name) {
-  printf("usage: %s [rows columns [mines]]\n", name);
+  printf("usage: %s [-r FILE] [rows columns [mines]]\n", name);
   printf("\tPlay minesweeper.\n");
+  printf("\t-r FILE: record the game to FILE (see replay)\n");
 }
 
 
@@ -204,14 +385,21 @@ static int gui_run(int argc, char **argv, int r, int c, int m)
   int status;
 
   game = msw_create(r, c, m);
+  if (record && msw_record(game, record, 1) < 0) {
+    msw_delete(game);
+    return EXIT_FAILURE;
+  }
+  worker = msw_aiworker_create(gui_hint_ready, NULL);
+  msw_aiworker_submit(worker, game);
   app = gtk_application_new("com.stephen-brennan.minesweeper",
                             G_APPLICATION_FLAGS_NONE);
   g_signal_connect(app, "activate", G_CALLBACK(gui_activate), NULL);
   status = g_application_run(G_APPLICATION(app), argc, argv);
   g_object_unref(app);
 
+  msw_aiworker_destroy(worker);
   msw_delete(game);
-  free(buttons);
+  gui_free_glyphs();
   return status;
 }
 
@@ -228,11 +416,19 @@ int gui_main(int argc, char *argv[])
     return EXIT_SUCCESS;
   }
 
+  // Record the game, if asked.
+  if (argc >= 3 && strcmp(argv[1], "-r") == 0) {
+    record = argv[2];
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
   // Set the grid size, if given.
   if (argc >= 3) {
     sscanf(argv[1], "%d", &r);
     sscanf(argv[2], "%d", &c);
-    if (r <= 0 || c <= 0 || r > 255 || c > 255) {
+    if (r <= 0 || c <= 0 || r > GUI_MAX_CELLS || c > GUI_MAX_CELLS) {
       fprintf(stderr, "error: bad grid size (%dx%d)\n", r, c);
       return EXIT_FAILURE;
     }
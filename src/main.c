@@ -17,10 +17,16 @@
 
 static void usage(char *name)
 {
-  printf("usage: %s [gui|cli]\n", name);
+  printf("usage: %s [gui|cli|curses|gen-corpus|replay|exact|analyze|tiled]\n",
+         name);
   printf("\tgui: Use the GTK version.\n");
   printf("\tcli: Use the command line version.\n");
   printf("\tcurses: Use the curses version.\n");
+  printf("\tgen-corpus: Write a file of boards for batch runs.\n");
+  printf("\treplay: Re-run recorded games.\n");
+  printf("\texact: Work out the best play for a small board.\n");
+  printf("\tanalyze: Summarize how hard many boards are.\n");
+  printf("\ttiled: Dig into a board too big to allocate.\n");
   exit(EXIT_FAILURE);
 }
 
@@ -36,6 +42,16 @@ int main(int argc, char *argv[])
     return cli_main(argc - 1, argv + 1);
   } else if (strcmp(argv[1], "curses") == 0) {
     return curses_main(argc - 1, argv + 1);
+  } else if (strcmp(argv[1], "gen-corpus") == 0) {
+    return gen_corpus_main(argc - 1, argv + 1);
+  } else if (strcmp(argv[1], "replay") == 0) {
+    return replay_main(argc - 1, argv + 1);
+  } else if (strcmp(argv[1], "exact") == 0) {
+    return exact_main(argc - 1, argv + 1);
+  } else if (strcmp(argv[1], "analyze") == 0) {
+    return analyze_main(argc - 1, argv + 1);
+  } else if (strcmp(argv[1], "tiled") == 0) {
+    return tiled_main(argc - 1, argv + 1);
   }
 
   usage(argv[0]);
@@ -7,22 +7,24 @@
 
 #include <stdbool.h> // bool
 #include <stdio.h>  // fprintf, fputc, scanf
-#include <stdlib.h> // srand, rand, calloc, malloc, free
+#include <stdlib.h> // calloc, malloc, free
 #include <string.h> // strcmp
 #include <time.h>   // time
 
 #include "minesweeper.h"
 
+#ifdef DEBUG
 #define dp(fmt, ...) fprintf(stderr, "%s:%d: " fmt, __FILE__, __LINE__, __VA_ARGS__)
+#else
+#define dp(fmt, ...) ((void)0)
+#endif
 
 /*
- * Define all eight neighbors for a cell.  The array rnbr is the offset from the
- * row for each neighbor, and the array cnbr is the offset from the column for
- * each neighbor.
+ * Cells outside every opening are labeled -1, except for numbers with no clear
+ * neighbor, which msw_metrics() looks for.
  */
-#define NUM_NEIGHBORS 8
-char rnbr[NUM_NEIGHBORS] = { -1, -1, -1, 0, 0, 1, 1, 1 };
-char cnbr[NUM_NEIGHBORS] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+#define MSW_ISLAND -2
+#define MSW_ISLAND_SEEN -3
 
 const char *MSW_MSG[] = {
 	"Make a move.",
@@ -37,8 +39,29 @@ const char *MSW_MSG[] = {
 	"You win!",
 	"Undo is not supported",
 	"End of undo history",
+	"Nothing to redo",
 };
 
+const char msw_chars[16] = {
+	'0', '1', '2', '3', '4', '5', '6', '7', '8',
+	MSW_MINE, MSW_UNKNOWN, MSW_FLAG, '?', '?', '?', '?',
+};
+
+static int msw_flag_cell(msw *game, int r, int c);
+static int msw_unflag_cell(msw *game, int r, int c);
+static int msw_undo_turn(msw *obj);
+static int msw_redo_turn(msw *obj);
+
+/*
+ * Every public game action reports itself here, so that recording a game
+ * doesn't depend on which interface is being played.
+ */
+static inline void msw_log_action(msw *game, int action, int r, int c, int rv)
+{
+	if (game->replay)
+		msw_replay_record(game, action, r, c, rv);
+}
+
 struct msw_mark {
 	int group_mines;
 	int group_count;
@@ -65,6 +88,24 @@ struct msw_ai_percell {
 	};
 };
 
+/*
+ * The hot paths for one size of board. Each is compiled once for any size, and
+ * again for each standard size with its rows and columns as constants (see
+ * MSW_GEOMETRIES), which msw_init() picks when it can.
+ */
+struct msw_engine {
+	void (*count_mines)(msw *obj);
+	void (*label_regions)(msw *obj);
+	int (*dig_cell)(msw *game, struct msw_loc loc);
+	int (*reveal_cell)(msw *game, int r, int c);
+	struct msw_ai_move (*ai_fill)(msw *game);
+};
+
+static const struct msw_engine *msw_engine_for(int rows, int columns);
+
+/* Bodies of the hot paths, inlined into each engine (see MSW_ENGINE()). */
+#define MSW_TEMPLATE static inline __attribute__((always_inline))
+
 /**
  * @brief Return whether or not a cell is in bounds.
  */
@@ -82,74 +123,555 @@ int msw_index(msw *game, int row, int column)
 	return row * game->columns + column;
 }
 
-static inline void msw_set_grid(msw *game, struct msw_loc loc, char val)
+/*
+ * The neighbors of a cell which are on the board, as a bit for each in the
+ * order of rnbr and cnbr.
+ */
+static inline unsigned int msw_neigh_mask(int r, int c, int R, int C)
 {
-	game->grid[loc.row * game->columns + loc.col] = val;
+	unsigned int mask = 0xFF;
+
+	if (r == 0)
+		mask &= ~0x07u;
+	if (r == R - 1)
+		mask &= ~0xE0u;
+	if (c == 0)
+		mask &= ~0x29u;
+	if (c == C - 1)
+		mask &= ~0x94u;
+	return mask;
 }
 
-static inline void msw_set_visible_noundo(msw *game, struct msw_loc loc, char val)
+static inline int msw_neigh_index(int i, int k, int C)
 {
-	game->visible[loc.row * game->columns + loc.col] = val;
+	return i + rnbr[k] * C + cnbr[k];
 }
-static inline void msw_set_visible(msw *game, struct msw_loc loc, char val)
+
+static inline struct msw_loc msw_neigh_loc(int r, int c, int k)
+{
+	return (struct msw_loc){.row=r + rnbr[k], .col=c + cnbr[k]};
+}
+
+/*
+ * Count the neighbors in a mask (of eight bits).
+ */
+static inline int msw_neigh_count(unsigned int mask)
 {
+	mask = mask - ((mask >> 1) & 0x55);
+	mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+	return (mask + (mask >> 4)) & 0x0F;
+}
+
+/*
+ * Run STMT for each neighbor in MASK, in order, with K declared as the
+ * neighbor's number. The loop is unrolled, so K is a constant, and so are the
+ * offsets from msw_neigh_index() once the columns are. STMT may return, but
+ * not break or continue.
+ */
+#define msw_unrolled_neigh(MASK, K, STMT) do { \
+	if ((MASK) & 0x01) { const int K = 0; STMT; } \
+	if ((MASK) & 0x02) { const int K = 1; STMT; } \
+	if ((MASK) & 0x04) { const int K = 2; STMT; } \
+	if ((MASK) & 0x08) { const int K = 3; STMT; } \
+	if ((MASK) & 0x10) { const int K = 4; STMT; } \
+	if ((MASK) & 0x20) { const int K = 5; STMT; } \
+	if ((MASK) & 0x40) { const int K = 6; STMT; } \
+	if ((MASK) & 0x80) { const int K = 7; STMT; } \
+} while (0)
+
+/*
+ * Find which of a cell's neighbors in mask are flagged, and which unknown,
+ * reading each once and without branching on what it holds.
+ */
+static inline __attribute__((always_inline)) void
+msw_neigh_states(const unsigned char *cells, int i, unsigned int mask,
+                 const int C, unsigned int *flagged, unsigned int *unknown)
+{
+	unsigned int f = 0, u = 0;
+	int vis;
+
+	msw_unrolled_neigh(mask, k,
+		vis = MSW_CELL_VIS(cells[msw_neigh_index(i, k, C)]);
+		f |= (unsigned int)(vis == MSW_CFLAG) << k;
+		u |= (unsigned int)(vis == MSW_CUNKNOWN) << k);
+	*flagged = f;
+	*unknown = u;
+}
+
+/**
+ * @brief Return the Zobrist key of a cell in a visible state.
+ *
+ * Keys are mixed from the index and state rather than stored, and are the same
+ * for every game. An unknown cell's key is 0, so a covered board hashes to 0.
+ */
+uint64_t msw_hash_cell(int index, char state)
+{
+	uint64_t z;
+
+	if (state == MSW_UNKNOWN)
+		return 0;
+	z = ((uint64_t)index << 8 | (unsigned char)state) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief Return a hash of the visible board, kept up to date as cells change.
+ *
+ * Two boards of the same size which look the same have the same hash.
+ */
+uint64_t msw_hash(msw *game)
+{
+	return game->hash;
+}
+
+/*
+ * Label the grid's openings, unless that's been done since it was numbered.
+ * Only digging a clear cell and measuring the board need them, so making a
+ * grid leaves it until then.
+ */
+static void msw_label_openings(msw *game)
+{
+	if (game->labeled)
+		return;
+	msw_trace_begin("label openings", -1);
+	game->engine->label_regions(game);
+	msw_trace_end("label openings");
+	game->labeled = 1;
+}
+
+/**
+ * @brief Return the 3BV of a game's board.
+ *
+ * 3BV ("Bechtel's Board Benchmark Value") is the fewest clicks which clear the
+ * board: one per opening, plus one per number which borders no opening. It is
+ * -1 before the first dig.
+ */
+int msw_3bv(msw *game)
+{
+	if (!game->has_grid)
+		return -1;
+	msw_label_openings(game);
+	return game->bbbv;
+}
+
+/**
+ * @brief Measure how hard a game's board is.
+ * @param game The game.
+ * @param metrics Receives the measurements.
+ * @returns 0, or -1 if there is no grid yet.
+ *
+ * Besides 3BV, this counts the openings and the islands: groups of numbers,
+ * touching each other, which no opening reveals. Each island's numbers have to
+ * be dug one at a time. It takes time linear in the size of the board.
+ */
+int msw_metrics(msw *game, struct msw_metrics *metrics)
+{
+	int R = game->rows, C = game->columns, ncells = R * C;
+	int *region, *stack = game->islands, top, i, j, k, r, c;
+
+	if (!game->has_grid)
+		return -1;
+	msw_label_openings(game);
+	region = game->region;
+	metrics->bbbv = game->bbbv;
+	metrics->openings = game->nregions;
+	metrics->islands = 0;
+
+	// Numbers outside every opening were marked when it was labeled.
+	// Flood each group of them, marking it as seen, then put the marks
+	// back.
+	if (stack == NULL) {
+		stack = game->islands = malloc(ncells * sizeof(int));
+		if (stack == NULL) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < ncells; i++) {
+		if (region[i] != MSW_ISLAND)
+			continue;
+		metrics->islands++;
+		region[i] = MSW_ISLAND_SEEN;
+		stack[0] = i;
+		top = 1;
+		while (top > 0) {
+			j = stack[--top];
+			for (k = 0; k < NUM_NEIGHBORS; k++) {
+				r = j / C + rnbr[k];
+				c = j % C + cnbr[k];
+				if (r < 0 || r >= R || c < 0 || c >= C ||
+				    region[r * C + c] != MSW_ISLAND)
+					continue;
+				region[r * C + c] = MSW_ISLAND_SEEN;
+				stack[top++] = r * C + c;
+			}
+		}
+	}
+	for (i = 0; i < ncells; i++)
+		if (region[i] == MSW_ISLAND_SEEN)
+			region[i] = MSW_ISLAND;
+	return 0;
+}
+
+/*
+ * Report a visible cell's change to whoever is listening.
+ */
+static void msw_note_change(msw *game, struct msw_loc loc, char old, char new)
+{
+	struct msw_change change = {.loc=loc, .old=old, .new=new};
+
+	if (game->changecap) {
+		if (game->nchanges == game->changecap) {
+			game->changecap *= 2;
+			game->changes = realloc(game->changes,
+				game->changecap * sizeof(struct msw_change));
+			if (game->changes == NULL) {
+				fprintf(stderr, "error: realloc() returned null.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		game->changes[game->nchanges++] = change;
+	}
+	if (game->on_change)
+		game->on_change(game, &change, game->change_arg);
+}
+
+/*
+ * Visible cells are set by code (see MSW_CELL()). Everything reported outside
+ * the game -- changes, the hash and the undo log -- still uses characters.
+ */
+static inline void msw_set_visible_noundo(msw *game, struct msw_loc loc,
+                                          int code)
+{
+	int idx = loc.row * game->columns + loc.col;
+	unsigned char cell = game->cells[idx];
+	char old = msw_chars[MSW_CELL_VIS(cell)];
+	char val = msw_chars[code];
+
+	if (game->changecap || game->on_change)
+		msw_note_change(game, loc, old, val);
+	game->hash ^= msw_hash_cell(idx, old) ^ msw_hash_cell(idx, val);
+	game->cells[idx] = MSW_CELL(code, MSW_CELL_GRID(cell));
+}
+static inline void msw_set_visible(msw *game, struct msw_loc loc, int code)
+{
+	int vis = MSW_CELL_VIS(game->cells[loc.row * game->columns + loc.col]);
+	struct msw_undo_entry *e;
+
+	if (vis == code)
+		return; /* don't log changes which aren't changes */
 	if (game->undo) {
-		game->undo[game->undoidx].gen = game->gen;
-		game->undo[game->undoidx].loc = loc;
-		game->undo[game->undoidx].old = msw_get_visible(game, loc);
+		e = &game->undo[game->undoidx];
+		e->gen = game->gen;
+		e->loc = loc;
+		e->old = msw_chars[vis];
+		e->new = msw_chars[code];
 		game->undoidx++;
 		game->undoidx %= game->undocap;
+		game->undoend = game->undoidx;
+		if (game->stats)
+			game->stats->undo_entries++;
 	}
-	msw_set_visible_noundo(game, loc, val);
+	msw_set_visible_noundo(game, loc, code);
+}
+
+/*
+ * Set a visible cell from the undo log, keeping the flag count in sync.
+ */
+static void msw_restore_visible(msw *game, struct msw_loc loc, char val)
+{
+	if (msw_get_visible(game, loc) == MSW_FLAG)
+		game->flags--;
+	if (val == MSW_FLAG)
+		game->flags++;
+	msw_set_visible_noundo(game, loc, msw_code(val));
+}
+
+static inline int msw_undo_prev(msw *game, int idx)
+{
+	return (idx + game->undocap - 1) % game->undocap;
+}
+
+/*
+ * A small, fast PRNG (splitmix64) local to each game, so that a seed always
+ * produces the same board regardless of platform or other rand() users.
+ */
+static uint64_t msw_rand(msw *game)
+{
+	uint64_t z = (game->rng += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Union-find over cell indices. Roots are always the smallest index in their
+ * set, so every parent comes before its child.
+ */
+static int msw_find(int *parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static int msw_union(int *parent, int a, int b)
+{
+	a = msw_find(parent, a);
+	b = msw_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+	return a != b;
 }
 
 /**
- * @brief Randomly generate a grid for this game.
+ * @brief Allocate n zeroed items, or exit if there isn't the memory.
  */
-void msw_generate_grid(msw *obj)
+void *msw_calloc(size_t n, size_t size)
+{
+	void *p = calloc(n ? n : 1, size);
+	if (p == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void *msw_realloc(void *p, size_t size)
+{
+	p = realloc(p, size ? size : 1);
+	if (p == NULL) {
+		fprintf(stderr, "error: realloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+/*
+ * Make room for n ints in a list which only grows, with *cap of them already.
+ */
+static int *msw_grow(int *p, int *cap, int n)
+{
+	if (n <= *cap)
+		return p;
+	*cap = n > 2 * *cap ? n : 2 * *cap;
+	return msw_realloc(p, *cap * sizeof(int));
+}
+
+/*
+ * Add an opening (if reg is one) to a list of n distinct ones, returning the
+ * new length.
+ */
+static inline int msw_add_region(int *out, int n, int reg)
+{
+	int k;
+
+	if (reg < 0)
+		return n;
+	for (k = 0; k < n; k++)
+		if (out[k] == reg)
+			return n;
+	out[n] = reg;
+	return n + 1;
+}
+
+/*
+ * Collect the distinct openings a numbered cell borders into out, returning
+ * how many there are.
+ */
+MSW_TEMPLATE int msw_bordered_regions(msw *obj, int r, int c, int *out,
+                                      const int R, const int C)
+{
+	unsigned int mask = msw_neigh_mask(r, c, R, C);
+	int i = r * C + c, n = 0;
+
+	msw_unrolled_neigh(mask, k, n = msw_add_region(out, n,
+		obj->region[msw_neigh_index(i, k, C)]));
+	return n;
+}
+
+/*
+ * Label the openings of a numbered grid: each connected group of clear cells,
+ * with the numbers around it, is revealed by digging any one of its clear
+ * cells. Also counts the board's 3BV, the fewest clicks that clear it.
+ */
+MSW_TEMPLATE void msw_label_regions_in(msw *obj, const int R, const int C)
+{
+	int ncells = R * C;
+	int *region, *start, r, c, i, k, n, reg[NUM_NEIGHBORS];
+	int up, left, right, label = 0;
+
+	if (obj->region == NULL)
+		obj->region = msw_realloc(NULL, ncells * sizeof(int));
+	region = obj->region;
+	obj->nregions = 0;
+	for (r = 0; r < R; r++) {
+		for (c = 0; c < C; c++) {
+			i = r * C + c;
+			if (MSW_CELL_GRID(obj->cells[i]) != MSW_CCLEAR) {
+				region[i] = -1;
+				continue;
+			}
+			// The cell above touches the other three neighbors
+			// already seen, and the left and upper left ones touch
+			// each other, so at most one union is ever needed.
+			up = r > 0 && region[i - C] >= 0 ? i - C : -1;
+			left = c > 0 && region[i - 1] >= 0 ? i - 1 :
+			       r > 0 && c > 0 && region[i - C - 1] >= 0 ?
+			       i - C - 1 : -1;
+			right = r > 0 && c < C - 1 && region[i - C + 1] >= 0 ?
+			        i - C + 1 : -1;
+			if (up >= 0) {
+				region[i] = up;
+			} else if (left >= 0) {
+				region[i] = left;
+				if (right >= 0)
+					obj->nregions -= msw_union(region, left,
+					                           right);
+			} else if (right >= 0) {
+				region[i] = right;
+			} else {
+				region[i] = i;
+				obj->nregions++;
+			}
+		}
+	}
+
+	// Number the sets in order of their roots. A parent always comes
+	// first, so by the time a cell is reached its parent holds the label.
+	// Alongside, count each opening's cells: its clear cells, and every
+	// number next to one (a row behind, once its neighbors are labeled).
+	// Isolated numbers each take a click of their own.
+	start = obj->regionstart = msw_grow(obj->regionstart, &obj->startcap,
+	                                    obj->nregions + 1);
+	memset(start, 0, (obj->nregions + 1) * sizeof(int));
+	obj->bbbv = obj->nregions;
+	for (r = 0; r <= R; r++) {
+		for (c = 0; r < R && c < C; c++) {
+			i = r * C + c;
+			if (region[i] < 0)
+				continue;
+			region[i] = region[i] == i ? label++ : region[region[i]];
+			start[region[i] + 1]++;
+		}
+		for (c = 0; r > 0 && c < C; c++) {
+			i = (r - 1) * C + c;
+			if (region[i] >= 0 ||
+			    MSW_CELL_GRID(obj->cells[i]) == MSW_CMINE)
+				continue;
+			n = msw_bordered_regions(obj, r - 1, c, reg, R, C);
+			if (n == 0) {
+				region[i] = MSW_ISLAND;
+				obj->bbbv++;
+			}
+			for (k = 0; k < n; k++)
+				start[reg[k] + 1]++;
+		}
+	}
+	for (k = 0; k < obj->nregions; k++)
+		start[k + 1] += start[k];
+	obj->regioncells = msw_grow(obj->regioncells, &obj->cellscap,
+	                            start[obj->nregions]);
+	for (i = 0; i < ncells; i++) {
+		if (region[i] >= 0) {
+			obj->regioncells[start[region[i]]++] = i;
+		} else if (region[i] != MSW_ISLAND &&
+		           MSW_CELL_GRID(obj->cells[i]) != MSW_CMINE) {
+			n = msw_bordered_regions(obj, i / C, i % C, reg, R,
+			                         C);
+			for (k = 0; k < n; k++)
+				obj->regioncells[start[reg[k]]++] = i;
+		}
+	}
+	// Filling advanced each start to the next one's; shift them back.
+	for (k = obj->nregions; k > 0; k--)
+		start[k] = start[k - 1];
+	start[0] = 0;
+}
+
+/*
+ * Scatter the game's mines randomly over a grid of clear cells. Only the grid
+ * halves of the cells change.
+ */
+static void msw_place_mines(msw *obj)
 {
 	int i, j;
-	char tmp;
+	unsigned char tmp, *cells = obj->cells;
 	int mines = obj->mines;
 	int ncells = obj->rows * obj->columns;
-	struct msw_loc loc, neigh;
-	int iter;
 
 	// Initialize the grid.
 	for (i = 0; i < ncells; i++) {
-		obj->grid[i] = MSW_CLEAR;
+		cells[i] &= 0xF0;
 	}
 
 	// Add the mines.
 	for (i = 0; i < mines; i++) {
-		obj->grid[i] = MSW_MINE;
+		cells[i] |= MSW_CMINE;
 	}
 
 	// Shuffle the mines. (Fisher-Yates)
 	for (i = ncells - 1; i > 0; i--) {
-		j = rand() % (i + 1);
-		tmp = obj->grid[j];
-		obj->grid[j] = obj->grid[i];
-		obj->grid[i] = tmp;
+		j = msw_rand(obj) % (i + 1);
+		tmp = MSW_CELL_GRID(cells[j]);
+		cells[j] = (cells[j] & 0xF0) | MSW_CELL_GRID(cells[i]);
+		cells[i] = (cells[i] & 0xF0) | tmp;
 	}
+	obj->has_grid = 1;
+}
 
-	// Count adjacent mines.
-	for_each_row_col(obj, loc)
-	{
-		tmp = msw_get_grid(obj, loc);
-
-		if (tmp == MSW_MINE)
-			continue;
+/**
+ * @brief Randomly generate a grid for this game.
+ */
+void msw_generate_grid(msw *obj)
+{
+	msw_trace_begin("generate", obj->rows * obj->columns);
+	msw_place_mines(obj);
+	msw_number_grid(obj);
+	msw_trace_end("generate");
+}
 
-		for_each_neigh(obj, neigh, &loc, iter)
-		{
-			if (msw_get_grid(obj, neigh) == MSW_MINE)
-				tmp++;
+/*
+ * Count each non-mine cell's adjacent mines.
+ */
+MSW_TEMPLATE void msw_count_mines_in(msw *obj, const int R, const int C)
+{
+	unsigned char *cells = obj->cells, *cell;
+	unsigned int mask;
+	int r, c, i;
+
+	// Count adjacent mines, by adding each mine to its neighbors' counts.
+	for (r = 0, i = 0; r < R; r++) {
+		for (c = 0; c < C; c++, i++) {
+			if (MSW_CELL_GRID(cells[i]) != MSW_CMINE)
+				continue;
+			mask = msw_neigh_mask(r, c, R, C);
+			msw_unrolled_neigh(mask, k,
+				cell = &cells[msw_neigh_index(i, k, C)];
+				if (MSW_CELL_GRID(*cell) != MSW_CMINE)
+					(*cell)++);
 		}
-		msw_set_grid(obj, loc, tmp);
 	}
 }
 
+/**
+ * @brief Fill in the count of adjacent mines for each non-mine cell.
+ *
+ * The grid must contain only MSW_CMINE and MSW_CCLEAR cells. The board's
+ * openings are labeled later, at the first dig into one.
+ */
+void msw_number_grid(msw *obj)
+{
+	obj->engine->count_mines(obj);
+	obj->labeled = 0;
+}
+
 /**
  * @brief Create the initial grid for a game.
  * @param obj The game.
@@ -163,17 +685,57 @@ void msw_generate_grid(msw *obj)
  */
 void msw_initial_grid(msw *obj, int r, int c)
 {
-	srand(time(NULL));
-
-	obj->grid = calloc(obj->rows * obj->columns, sizeof(char));
-	if (obj->grid == NULL) {
-		fprintf(stderr, "error: calloc() returned null.\n");
-		exit(EXIT_FAILURE);
-	}
+	obj->rng = msw_get_seed(obj);
 
+	msw_trace_begin("generate", obj->rows * obj->columns);
 	do {
-		msw_generate_grid(obj);
-	} while (obj->grid[msw_index(obj, r, c)] != MSW_CLEAR);
+		msw_place_mines(obj);
+		obj->engine->count_mines(obj);
+	} while (MSW_CELL_GRID(obj->cells[msw_index(obj, r, c)]) !=
+	         MSW_CCLEAR);
+	obj->labeled = 0;
+	msw_trace_end("generate");
+}
+
+/**
+ * @brief Generate a grid straight from the game's seed.
+ *
+ * Unlike the grid made at the first dig, nothing guarantees any cell is clear.
+ * The visible board is left alone, so a game can be reused.
+ */
+void msw_new_grid(msw *obj)
+{
+	obj->rng = obj->seed;
+	msw_generate_grid(obj);
+}
+
+/**
+ * @brief Load a grid from a bitmap of mines.
+ * @param obj The game.
+ * @param mines One bit per cell in row-major order, least significant bit
+ * first. A set bit is a mine.
+ *
+ * The visible board is left alone, so a game can be reused.
+ */
+void msw_load_mines(msw *obj, const unsigned char *mines)
+{
+	int i, bit;
+	int ncells = obj->rows * obj->columns;
+	unsigned int byte;
+
+	for (i = 0; i < ncells; i++)
+		obj->cells[i] &= 0xF0;
+	for (i = 0; i < ncells; i += 8) {
+		byte = mines[i / 8];
+		while (byte) {
+			bit = __builtin_ctz(byte);
+			if (i + bit < ncells)
+				obj->cells[i + bit] |= MSW_CMINE;
+			byte &= byte - 1;
+		}
+	}
+	obj->has_grid = 1;
+	msw_number_grid(obj);
 }
 
 /**
@@ -181,64 +743,180 @@ void msw_initial_grid(msw *obj, int r, int c)
  */
 void msw_init(msw *obj, int rows, int columns, int mines)
 {
-	int i;
 	int ncells = rows * columns;
 
 	// Initialization logic
 	obj->rows = rows;
 	obj->columns = columns;
 	obj->mines = mines;
-	obj->grid = NULL;
-	obj->visible = calloc(ncells, sizeof(char));
-	obj->ai = calloc(ncells, sizeof(struct msw_ai_percell));
+	obj->has_grid = 0;
+	obj->region = obj->regionstart = obj->regioncells = NULL;
+	obj->startcap = obj->cellscap = 0;
+	obj->islands = NULL;
+	obj->nregions = obj->bbbv = obj->labeled = 0;
+	obj->seed = 0;
+	obj->rng = 0;
+	obj->hash = 0;
+	obj->replay = NULL;
+	obj->changes = NULL;
+	obj->nchanges = obj->changecap = 0;
+	obj->on_change = NULL;
+	obj->change_arg = NULL;
+	obj->stats = NULL;
+	obj->flood_threads = 0;
+	obj->engine = msw_engine_for(rows, columns);
+	obj->cells = malloc(ncells);
+	obj->ai = NULL; /* allocated by the first msw_ai() call */
 	obj->undo = NULL;
 	obj->gen = 1;
 	obj->undoidx = 0;
+	obj->undocap = 0;
+	obj->undoend = 0;
 	obj->flags = 0;
-	if (obj->visible == NULL) {
-		fprintf(stderr, "error: calloc() returned null.\n");
+	if (obj->cells == NULL) {
+		fprintf(stderr, "error: malloc() returned null.\n");
 		exit(EXIT_FAILURE);
 	}
 
-	// Initialize the visible board and underlying grid.
-	for (i = 0; i < ncells; i++) {
-		obj->visible[i] = MSW_UNKNOWN;
-	}
+	// Initialize the visible board. The grid comes at the first dig.
+	memset(obj->cells, MSW_CELL(MSW_CUNKNOWN, MSW_CCLEAR), ncells);
 }
 
 void msw_enable_undo_logging(msw *obj, int cap)
 {
 	if (!obj->undo) {
-		obj->undo = calloc(cap, sizeof(struct msw_undo_entry));
+		obj->undo = msw_calloc(cap, sizeof(struct msw_undo_entry));
 		obj->undoidx = 1;
+		obj->undoend = 1;
 		obj->undocap = cap;
 		obj->undo[0].gen = obj->gen - 1;
 		obj->gen = 2;
 	}
 }
 
+/**
+ * @brief Cover the whole board again, as if no moves had been made.
+ *
+ * The grid, the allocations and the undo log's capacity are kept, which makes
+ * this cheap enough to do between games on the same board. Pending changes are
+ * discarded rather than reported.
+ */
+void msw_reset(msw *obj)
+{
+	int i;
+
+	for (i = 0; i < obj->rows * obj->columns; i++)
+		obj->cells[i] = MSW_CELL(MSW_CUNKNOWN,
+		                         MSW_CELL_GRID(obj->cells[i]));
+	obj->hash = 0;
+	obj->flags = 0;
+	obj->nchanges = 0;
+	obj->gen = 1;
+	if (obj->undo) {
+		obj->undo[0].gen = 0;
+		obj->undoidx = obj->undoend = 1;
+		obj->gen = 2;
+	}
+}
+
+/**
+ * @brief Set the seed used to generate the grid.
+ *
+ * Must be called before the first dig. Two games with the same geometry, seed
+ * and first dig always get the same grid.
+ */
+void msw_set_seed(msw *obj, uint64_t seed)
+{
+	obj->seed = seed;
+}
+
+/**
+ * @brief Start or stop collecting the visible cells changed each turn.
+ *
+ * While enabled, every change to a visible cell (including those made by undo
+ * and redo) is appended to a list which msw_changes() returns, and which
+ * msw_end_turn() empties. Frontends can use it to redraw only what changed.
+ */
+void msw_track_changes(msw *obj, int enable)
+{
+	free(obj->changes);
+	obj->changes = NULL;
+	obj->nchanges = obj->changecap = 0;
+	if (enable) {
+		obj->changecap = 64;
+		obj->changes = malloc(obj->changecap * sizeof(struct msw_change));
+		if (obj->changes == NULL) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * @brief Call a function for every change to a visible cell, as it happens.
+ *
+ * Pass NULL to stop. This works independently of msw_track_changes().
+ */
+void msw_set_change_callback(msw *obj, msw_change_fn fn, void *arg)
+{
+	obj->on_change = fn;
+	obj->change_arg = arg;
+}
+
+/**
+ * @brief Return the visible cells changed since the last msw_end_turn().
+ * @param obj The game.
+ * @param count Receives the number of changes, in the order they were made.
+ */
+const struct msw_change *msw_changes(msw *obj, int *count)
+{
+	*count = obj->nchanges;
+	return obj->changes;
+}
+
+/**
+ * @brief Return the seed of the grid, choosing one now if none was set.
+ */
+uint64_t msw_get_seed(msw *obj)
+{
+	if (obj->seed == 0)
+		obj->seed = (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)obj;
+	return obj->seed;
+}
+
 void msw_end_turn(msw *obj)
 {
+	msw_log_action(obj, MSW_AENDTURN, 0, 0, MSW_MMOVE);
+	obj->nchanges = 0;
+	if (!obj->undo)
+		return;
 	/* only increment generation if changes were made */
-	if (obj->undo[(obj->undoidx - 1) % obj->undocap].gen == obj->gen)
+	if (obj->undo[msw_undo_prev(obj, obj->undoidx)].gen == obj->gen)
 		obj->gen++;
 }
 
 int msw_undo(msw *obj)
+{
+	uint64_t start = msw_stats_begin(obj);
+	int rv = msw_undo_turn(obj);
+	msw_log_action(obj, MSW_AUNDO, 0, 0, rv);
+	msw_stats_end(obj, MSW_CALL_UNDO, start);
+	return rv;
+}
+
+static int msw_undo_turn(msw *obj)
 {
 	if (!obj->undo)
 		return MSW_MNOUNDO;
 	int count = 0;
+	int idx = msw_undo_prev(obj, obj->undoidx);
 	dp("undo generation %d, idx %d\n", obj->gen, obj->undoidx);
-	for (obj->undoidx = (obj->undoidx - 1) % obj->undocap;
-	     obj->undo[obj->undoidx].gen == obj->gen - 1;
-	     obj->undoidx = (obj->undoidx - 1) % obj->undocap) {
-		msw_set_visible_noundo(obj, obj->undo[obj->undoidx].loc,
-				       obj->undo[obj->undoidx].old);
-		obj->undo[obj->undoidx].gen = 0;
+	while (count < obj->undocap - 1 && obj->undo[idx].gen == obj->gen - 1) {
+		msw_restore_visible(obj, obj->undo[idx].loc, obj->undo[idx].old);
+		obj->undoidx = idx;
+		idx = msw_undo_prev(obj, idx);
 		count += 1;
 	}
-	obj->undoidx = (obj->undoidx + 1) % obj->undocap;
 	if (!count) {
 		dp("cannot undo any more, %d, idx %d\n", obj->gen, obj->undoidx);
 		return MSW_MENDUNDO;
@@ -247,6 +925,38 @@ int msw_undo(msw *obj)
 	return MSW_MMOVE;
 }
 
+/**
+ * @brief Re-apply the most recently undone turn.
+ *
+ * Any change made after an undo discards the redo history.
+ */
+int msw_redo(msw *obj)
+{
+	uint64_t start = msw_stats_begin(obj);
+	int rv = msw_redo_turn(obj);
+	msw_log_action(obj, MSW_AREDO, 0, 0, rv);
+	msw_stats_end(obj, MSW_CALL_REDO, start);
+	return rv;
+}
+
+static int msw_redo_turn(msw *obj)
+{
+	if (!obj->undo)
+		return MSW_MNOUNDO;
+	int count = 0;
+	while (obj->undoidx != obj->undoend &&
+	       obj->undo[obj->undoidx].gen == obj->gen) {
+		msw_restore_visible(obj, obj->undo[obj->undoidx].loc,
+		                    obj->undo[obj->undoidx].new);
+		obj->undoidx = (obj->undoidx + 1) % obj->undocap;
+		count += 1;
+	}
+	if (!count)
+		return MSW_MNOREDO;
+	obj->gen += 1;
+	return MSW_MMOVE;
+}
+
 /**
  * @brief Create a minesweeper game.
  */
@@ -267,10 +977,16 @@ msw *msw_create(int rows, int columns, int mines)
 void msw_destroy(msw *obj)
 {
 	// Cleanup logic
-	free(obj->grid);
-	free(obj->visible);
+	msw_record_stop(obj);
+	free(obj->cells);
+	free(obj->region);
+	free(obj->regionstart);
+	free(obj->regioncells);
+	free(obj->islands);
 	free(obj->ai);
 	free(obj->undo);
+	free(obj->changes);
+	free(obj->stats);
 }
 
 /**
@@ -290,45 +1006,57 @@ void msw_delete(msw *obj)
  * @brief Print the current board to the given output stream.
  * @param game The game to print.
  * @param stream The stream to print to.
- * @param buffer Which buffer to print -- the visible one or the true one.
+ * @param grid Whether to print the true grid rather than the visible board.
  */
-void msw_print_buf(msw *game, FILE *stream, char *buffer)
+void msw_print_buf(msw *game, FILE *stream, int grid)
 {
+	unsigned char cell;
 	int i, j;
-	char cell;
+	int width = game->columns + 16; // row label, newline, slack
+	char *out, *p;
+
+	// Build the whole board in memory so it goes out in a single write.
+	out = malloc((size_t)width * (game->rows + 3));
+	if (out == NULL) {
+		fprintf(stderr, "error: malloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	p = out;
 
 	// Print tens row:
-	fprintf(stream, "  | ");
+	memcpy(p, "  | ", 4);
+	p += 4;
 	for (i = 0; i < game->columns; i++) {
-		if (i % 10 == 0) {
-			fputc('0' + i / 10, stream);
-		} else {
-			fputc(' ', stream);
-		}
+		*p++ = i % 10 == 0 ? '0' + i / 10 : ' ';
 	}
 
 	// Print the ones row:
-	fprintf(stream, "\n  | ");
+	memcpy(p, "\n  | ", 5);
+	p += 5;
 	for (i = 0; i < game->columns; i++) {
-		fputc('0' + i % 10, stream);
+		*p++ = '0' + i % 10;
 	}
 
 	// Print the underline row:
-	fprintf(stream, "\n--|-");
-	for (i = 0; i < game->columns; i++) {
-		fputc('-', stream);
-	}
-	fputc('\n', stream);
+	memcpy(p, "\n--|-", 5);
+	p += 5;
+	memset(p, '-', game->columns);
+	p += game->columns;
+	*p++ = '\n';
 
 	// Print each row in the game board.
 	for (i = 0; i < game->rows; i++) {
-		fprintf(stream, "%2d| ", i);
+		p += sprintf(p, "%2d| ", i);
 		for (j = 0; j < game->columns; j++) {
-			cell = buffer[msw_index(game, i, j)];
-			fputc(cell, stream);
+			cell = game->cells[msw_index(game, i, j)];
+			*p++ = msw_chars[grid ? MSW_CELL_GRID(cell) :
+			                        MSW_CELL_VIS(cell)];
 		}
-		fputc('\n', stream);
+		*p++ = '\n';
 	}
+
+	fwrite(out, 1, p - out, stream);
+	free(out);
 }
 
 /**
@@ -336,7 +1064,19 @@ void msw_print_buf(msw *game, FILE *stream, char *buffer)
  */
 void msw_print(msw *game, FILE *stream)
 {
-	msw_print_buf(game, stream, game->visible);
+	msw_print_buf(game, stream, 0);
+}
+
+/**
+ * @brief Write a game's visible board as characters, one per cell in row-major
+ * order (rows * columns of them, without a terminator).
+ */
+void msw_visible_chars(msw *game, char *out)
+{
+	int i;
+
+	for (i = 0; i < game->rows * game->columns; i++)
+		out[i] = msw_chars[MSW_CELL_VIS(game->cells[i])];
 }
 
 /**
@@ -348,53 +1088,116 @@ void msw_print(msw *game, FILE *stream)
  */
 int msw_dig(msw *game, int row, int column)
 {
-	int iter;
-	struct msw_loc neigh, loc = {.row=row, .col=column};
+	int rv;
+	struct msw_loc loc = {.row=row, .col=column};
+	uint64_t start = msw_stats_begin(game);
 
 	// If the cell is out of bounds, return some sort of error.
 	if (!msw_in_bounds(game, row, column)) {
-		return MSW_MBOUND;
-	}
-
-	// If the game hasn't started yet (i.e. the grid is null).
-	if (game->grid == NULL) {
-		// Initialize the game so that we have a 0 at the selected cell.
-		msw_initial_grid(game, row, column);
+		rv = MSW_MBOUND;
+	} else {
+		// If the game hasn't started yet (i.e. there is no grid).
+		if (!game->has_grid) {
+			// Initialize the game so that we have a 0 at the selected cell.
+			msw_initial_grid(game, row, column);
+		}
+		rv = game->engine->dig_cell(game, loc);
 	}
+	msw_log_action(game, MSW_ADIG, row, column, rv);
+	msw_stats_end(game, MSW_CALL_DIG, start);
+	return rv;
+}
 
-	if (msw_get_grid(game, loc) == MSW_CLEAR &&
-	    msw_get_visible(game, loc) != MSW_CLEAR) {
-		// If the selected cell is clear, and we haven't updated the
-		// display with that information, update the display, and then
-		// recursively dig at each neighbor.
-		msw_set_visible(game, loc, MSW_CLEAR);
-		for_each_neigh(game, neigh, &loc, iter)
-		{
-			msw_dig(game, neigh.row, neigh.col);
-		}
-		return MSW_MMOVE;
-	} else if (msw_get_visible(game, loc) == MSW_FLAG) {
+/*
+ * Reveal a cell which is not clear, the way digging it would.
+ */
+static inline int msw_dig_uncover(msw *game, struct msw_loc loc,
+                                  unsigned char cell)
+{
+	if (MSW_CELL_VIS(cell) == MSW_CFLAG) {
 		// If the selected cell is a flag, do nothing.
 		return MSW_FLAGGED;
-	} else if (msw_get_grid(game, loc) == MSW_MINE) {
+	} else if (MSW_CELL_GRID(cell) == MSW_CMINE) {
 		// If the selected cell is a mine.
-		msw_set_visible(game, loc, MSW_MINE);
+		msw_set_visible(game, loc, MSW_CMINE);
 		return MSW_MBOOM; // BOOM
 	} else {
 		// Otherwise, reveal the data in the grid.
-		msw_set_visible(game, loc, msw_get_grid(game, loc));
+		msw_set_visible(game, loc, MSW_CELL_GRID(cell));
 		return MSW_MMOVE;
 	}
 }
 
+/*
+ * Dig at an in-bounds cell of a game whose grid exists.
+ *
+ * Digging a clear cell digs all of its neighbors too, which uncovers the whole
+ * opening it belongs to. Once the openings are labeled (at the first such dig),
+ * this just walks the opening's list of cells -- on several threads, if it is
+ * a giant one (see flood.c).
+ */
+MSW_TEMPLATE int msw_dig_cell_in(msw *game, struct msw_loc loc, const int C)
+{
+	int idx = loc.row * C + loc.col;
+	const int *cell, *end;
+	long n;
+	unsigned char c = game->cells[idx];
+
+	if (MSW_CELL_GRID(c) != MSW_CCLEAR || MSW_CELL_VIS(c) == MSW_CCLEAR) {
+		if (game->stats)
+			msw_stats_dig(game->stats,
+			              MSW_CELL_VIS(c) == MSW_CUNKNOWN, 0);
+		return msw_dig_uncover(game, loc, c);
+	}
+
+	msw_label_openings(game);
+	cell = game->regioncells + game->regionstart[game->region[idx]];
+	end = game->regioncells + game->regionstart[game->region[idx] + 1];
+	msw_trace_begin("opening", end - cell);
+	n = msw_flood(game, cell, end);
+	if (n >= 0)
+		cell = end;
+	else
+		n = 0;
+	for (; cell < end; cell++) {
+		c = game->cells[*cell];
+		if (MSW_CELL_VIS(c) == MSW_CELL_GRID(c))
+			continue;
+		loc.row = *cell / C;
+		loc.col = *cell % C;
+		if (MSW_CELL_GRID(c) == MSW_CCLEAR) {
+			if (MSW_CELL_VIS(c) == MSW_CFLAG)
+				game->flags--;
+			msw_set_visible(game, loc, MSW_CCLEAR);
+		} else if (msw_dig_uncover(game, loc, c) == MSW_FLAGGED)
+			continue;
+		n++;
+	}
+	msw_trace_end("opening");
+	if (game->stats)
+		msw_stats_dig(game->stats, n, 1);
+	return MSW_MMOVE;
+}
+
 /**
  * @brief Stick a flag in a cell.
  */
 int msw_flag(msw *game, int r, int c)
+{
+	uint64_t start = msw_stats_begin(game);
+	int rv = msw_flag_cell(game, r, c);
+	msw_log_action(game, MSW_AFLAG, r, c, rv);
+	msw_stats_end(game, MSW_CALL_FLAG, start);
+	return rv;
+}
+
+static int msw_flag_cell(msw *game, int r, int c)
 {
 	struct msw_loc loc = {.row=r, .col=c};
+	if (!msw_in_bounds(game, r, c))
+		return MSW_MBOUND;
 	if (msw_get_visible(game, loc) == MSW_UNKNOWN) {
-		msw_set_visible(game, loc, MSW_FLAG);
+		msw_set_visible(game, loc, MSW_CFLAG);
 		game->flags++;
 		return MSW_MMOVE;
 	} else {
@@ -406,10 +1209,21 @@ int msw_flag(msw *game, int r, int c)
  * @brief Unflag a cell.
  */
 int msw_unflag(msw *game, int r, int c)
+{
+	uint64_t start = msw_stats_begin(game);
+	int rv = msw_unflag_cell(game, r, c);
+	msw_log_action(game, MSW_AUNFLAG, r, c, rv);
+	msw_stats_end(game, MSW_CALL_UNFLAG, start);
+	return rv;
+}
+
+static int msw_unflag_cell(msw *game, int r, int c)
 {
 	struct msw_loc loc = {.row=r, .col=c};
+	if (!msw_in_bounds(game, r, c))
+		return MSW_MBOUND;
 	if (msw_get_visible(game, loc) == MSW_FLAG) {
-		msw_set_visible(game, loc, MSW_UNKNOWN);
+		msw_set_visible(game, loc, MSW_CUNKNOWN);
 		game->flags--;
 		return MSW_MMOVE;
 	} else {
@@ -425,55 +1239,78 @@ int msw_unflag(msw *game, int r, int c)
  */
 int msw_reveal(msw *game, int r, int c)
 {
-	int rv, iter;
-	int nflags = 0;
-	int nmarks = game->visible[msw_index(game, r, c)] - '0';
-	struct msw_loc neigh, loc = {.row=r, .col=c};
-	char val = msw_get_visible(game, loc);
+	uint64_t start = msw_stats_begin(game);
+	int rv = game->engine->reveal_cell(game, r, c);
+	msw_log_action(game, MSW_AREVEAL, r, c, rv);
+	msw_stats_end(game, MSW_CALL_REVEAL, start);
+	return rv;
+}
 
-	if (val == MSW_UNKNOWN || val == MSW_MINE || val == MSW_FLAG) {
+/*
+ * Whether digging a cell does anything: it is unknown, or it is a clear cell
+ * under a flag (which an opening uncovers anyway), or an exploded mine (which
+ * explodes again).
+ */
+static inline int msw_diggable(unsigned char cell)
+{
+	return MSW_CELL_VIS(cell) == MSW_CUNKNOWN ||
+	       MSW_CELL_VIS(cell) == MSW_CMINE ||
+	       cell == MSW_CELL(MSW_CFLAG, MSW_CCLEAR);
+}
+
+/*
+ * Reveal (chord) with the engine's own dig, which each neighbor calls
+ * directly.
+ *
+ * One pass over the neighbors finds which are flagged and which digging would
+ * change, so checking the flags is a count of bits, and the other neighbors
+ * are never dug. Digging one may uncover others (if it opens an opening), so
+ * each is looked at again before it is dug.
+ */
+MSW_TEMPLATE int msw_reveal_cell_in(msw *game, int r, int c, const int R,
+                                    const int C,
+                                    int (*dig)(msw *, struct msw_loc))
+{
+	int rv, idx, nbr, nmarks;
+	unsigned int mask, flagged = 0, todo = 0;
+	unsigned char *cells = game->cells, cell;
+
+	if (r < 0 || r >= R || c < 0 || c >= C)
+		return MSW_MBOUND;
+	idx = r * C + c;
+	nmarks = MSW_CELL_VIS(cells[idx]);
+
+	// Only a number can be revealed, and its code is its value.
+	if (nmarks >= MSW_CMINE) {
 		return MSW_MREVEALHF;
 	}
 
-	// Count the flags around the cell.
-	for_each_neigh(game, neigh, &loc, iter)
-	{
-		if (msw_get_visible(game, neigh) == MSW_FLAG) {
-			nflags++;
-		}
-	}
+	mask = msw_neigh_mask(r, c, R, C);
+	msw_unrolled_neigh(mask, k,
+		cell = cells[msw_neigh_index(idx, k, C)];
+		flagged |= (unsigned int)(MSW_CELL_VIS(cell) == MSW_CFLAG) << k;
+		todo |= (unsigned int)msw_diggable(cell) << k);
 
 	// If there are at least n flags, we can dig around the cell.
-	if (nflags >= nmarks) {
-		for_each_neigh(game, neigh, &loc, iter)
-		{
-			rv = msw_dig(game, neigh.row, neigh.col);
-			if (!MSW_MOK(rv))
-				return rv;
-		}
-		return MSW_MMOVE;
-	} else {
+	if (msw_neigh_count(flagged) < nmarks)
 		return MSW_MREVEALN;
+	for (; todo; todo &= todo - 1) {
+		nbr = __builtin_ctz(todo);
+		if (!msw_diggable(cells[msw_neigh_index(idx, nbr, C)]))
+			continue;
+		rv = dig(game, msw_neigh_loc(r, c, nbr));
+		if (!MSW_MOK(rv))
+			return rv;
 	}
+	return MSW_MMOVE;
 }
 
 int msw_won(msw *game)
 {
-	struct msw_loc loc;
-	char val, vis;
-	for_each_row_col(game, loc)
-	{
-		val = msw_get_grid(game, loc);
-		vis = msw_get_visible(game, loc);
-		if (val == MSW_MINE) {
-			if (vis != MSW_UNKNOWN && vis != MSW_FLAG) {
-				return 0;
-			}
-		} else if (val != vis) {
-			return 0;
-		}
-	}
-	return 1;
+	uint64_t start = msw_stats_begin(game);
+	int rv = msw_scan_won(game);
+	msw_stats_end(game, MSW_CALL_WON, start);
+	return rv;
 }
 
 static inline struct msw_ai_percell *msw_get_percell(msw *game, struct msw_loc loc)
@@ -501,39 +1338,36 @@ static void msw_observe_mark(int generation, struct msw_mark *mark, struct msw_m
 	}
 }
 
-static struct msw_ai_move msw_ai_fill_cell(msw *game, struct msw_loc loc)
+MSW_TEMPLATE struct msw_ai_move msw_ai_fill_cell_in(msw *game, int r, int c,
+                                                    const int R, const int C)
 {
-	struct msw_loc neigh;
-	struct msw_ai_percell *pc;
+	struct msw_ai_percell *pc, *ai = game->ai;
 	struct msw_ai_move move;
-	char val, neighval;
-	int iter;
+	unsigned char *cells = game->cells;
+	unsigned int mask, flagged, unknown;
+	int i = r * C + c, vis;
 
 	move.action = AI_NONE;
-	val = msw_get_visible(game, loc);
-	pc = msw_get_percell(game, loc);
+	vis = MSW_CELL_VIS(cells[i]);
+	pc = &ai[i];
 
-	if (val == MSW_UNKNOWN || val == MSW_CLEAR || val == MSW_FLAG)
+	if (vis == MSW_CUNKNOWN || vis == MSW_CCLEAR || vis == MSW_CFLAG)
 		return move;
 
-	pc->mine_count = val - '0';
+	pc->mine_count = msw_chars[vis] - '0';
 
 	// count flagged / unknown neighbors
-	for_each_neigh(game, neigh, &loc, iter)
-	{
-		neighval = msw_get_visible(game, neigh);
-		pc->total_neighbors += 1;
-		if (neighval == MSW_FLAG)
-			pc->flagged_neighbors += 1;
-		else if (neighval == MSW_UNKNOWN)
-			pc->unknown_neighbors += 1;
-	}
+	mask = msw_neigh_mask(r, c, R, C);
+	msw_neigh_states(cells, i, mask, C, &flagged, &unknown);
+	pc->total_neighbors = msw_neigh_count(mask);
+	pc->flagged_neighbors = msw_neigh_count(flagged);
+	pc->unknown_neighbors = msw_neigh_count(unknown);
 
 	if (pc->flagged_neighbors == pc->mine_count) {
 		/* All mines accounted for. Reveal if necessary, we're done here. */
 		if (pc->unknown_neighbors > 0) {
 			move.action = AI_REVEAL;
-			move.loc = loc;
+			move.loc = (struct msw_loc){.row=r, .col=c};
 			move.description = "Reveal (flag count matches cell count)";
 		}
 		return move;
@@ -542,25 +1376,37 @@ static struct msw_ai_move msw_ai_fill_cell(msw *game, struct msw_loc loc)
 		/* All unknowns are mines, flag them. */
 		move.action = AI_FLAG;
 		move.description = "Flag (only option for remaining unknowns)";
-		for_each_neigh(game, neigh, &loc, iter)
-		{
-			neighval = msw_get_visible(game, neigh);
-			if (neighval == MSW_UNKNOWN) {
-				move.loc = neigh;
-				return move;
-			}
-		}
+		if (unknown)
+			move.loc = msw_neigh_loc(r, c, __builtin_ctz(unknown));
 		return move;
 	}
 
 	/* at this point, we have more unknowns than mines, define group */
 	pc->mark.group_mines = pc->mine_count - pc->flagged_neighbors;
 	pc->mark.group_count = pc->unknown_neighbors;
-	for_each_neigh(game, neigh, &loc, iter)
-	{
-		neighval = msw_get_visible(game, neigh);
-		if (neighval == MSW_UNKNOWN) {
-			msw_ai_add_mark(msw_get_percell(game, neigh), &pc->mark);
+	for (; unknown; unknown &= unknown - 1)
+		msw_ai_add_mark(&ai[msw_neigh_index(i, __builtin_ctz(unknown),
+		                                    C)], &pc->mark);
+	if (game->stats)
+		game->stats->marks += pc->unknown_neighbors;
+	return move;
+}
+
+/*
+ * The AI's simple stage: fill in every number's neighbors and marks, up to the
+ * first one which makes a move.
+ */
+MSW_TEMPLATE struct msw_ai_move msw_ai_fill_in(msw *game, const int R,
+                                               const int C)
+{
+	struct msw_ai_move move = {.action=AI_NONE};
+	int r, c;
+
+	for (r = 0; r < R; r++) {
+		for (c = 0; c < C; c++) {
+			move = msw_ai_fill_cell_in(game, r, c, R, C);
+			if (move.action != AI_NONE)
+				return move;
 		}
 	}
 	return move;
@@ -672,27 +1518,54 @@ static struct msw_ai_move msw_ai_process_groups(msw *game, struct msw_loc loc)
 	return move;
 }
 
-struct msw_ai_move msw_ai(msw *game)
+/**
+ * @brief Look for a move which follows from the board for certain.
+ * @param game The game.
+ * @param stage If not NULL, receives the stage which found the move:
+ * MSW_AI_SIMPLE or MSW_AI_GROUPS.
+ * @returns The move, or AI_NONE if neither stage found one.
+ */
+struct msw_ai_move msw_ai_deduce(msw *game, int *stage)
 {
 	struct msw_loc loc;
 	struct msw_ai_move move;
 
+	if (game->ai == NULL) {
+		game->ai = malloc(sizeof(struct msw_ai_percell) * game->rows *
+		                  game->columns);
+		if (game->ai == NULL) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 	memset(game->ai, 0, sizeof(struct msw_ai_percell) * game->rows * game->columns);
-	for_each_row_col(game, loc)
-	{
-		move = msw_ai_fill_cell(game, loc);
-		if (move.action != AI_NONE)
-			return move;
+	if (game->stats)
+		game->stats->ai_stage[MSW_AI_SIMPLE]++;
+	msw_trace_begin("simple", -1);
+	move = game->engine->ai_fill(game);
+	msw_trace_end("simple");
+	if (move.action != AI_NONE) {
+		if (stage)
+			*stage = MSW_AI_SIMPLE;
+		return move;
 	}
 
 	dp("Stumped: trying groups%c", '\n');
+	if (game->stats)
+		game->stats->ai_stage[MSW_AI_GROUPS]++;
 
+	msw_trace_begin("groups", -1);
 	for_each_row_col(game, loc)
 	{
 		move = msw_ai_process_groups(game, loc);
-		if (move.action != AI_NONE)
+		if (move.action != AI_NONE) {
+			if (stage)
+				*stage = MSW_AI_GROUPS;
+			msw_trace_end("groups");
 			return move;
+		}
 	}
+	msw_trace_end("groups");
 
 	return (struct msw_ai_move) {
 		.action = AI_NONE,
@@ -700,3 +1573,166 @@ struct msw_ai_move msw_ai(msw *game)
 		.description = "I'm stumped!",
 	};
 }
+
+struct msw_ai_move msw_ai(msw *game)
+{
+	uint64_t start = msw_stats_begin(game);
+	struct msw_ai_move move;
+
+	msw_trace_begin("ai", -1);
+	move = msw_ai_deduce(game, NULL);
+	msw_trace_end("ai");
+	msw_stats_end(game, MSW_CALL_AI, start);
+	return move;
+}
+
+/**
+ * @brief Carry out a move suggested by msw_ai().
+ * @returns The status of the move, or MSW_MMOVE if the AI had nothing to do.
+ */
+int msw_ai_apply(msw *game, struct msw_ai_move move)
+{
+	switch (move.action) {
+	case AI_DIG:
+		return msw_dig(game, move.loc.row, move.loc.col);
+	case AI_REVEAL:
+		return msw_reveal(game, move.loc.row, move.loc.col);
+	case AI_FLAG:
+		return msw_flag(game, move.loc.row, move.loc.col);
+	default:
+		return MSW_MMOVE;
+	}
+}
+
+/**
+ * @brief Estimate the probability that each cell contains a mine.
+ * @param game The game to analyze.
+ * @param out Array of rows * columns doubles, indexed like msw_index().
+ *
+ * Revealed cells are 0, flags and exploded mines are 1. An unknown cell next to
+ * a satisfied number is 0. Otherwise it gets the highest density implied by any
+ * numbered neighbor (remaining mines over remaining unknowns), or the density of
+ * the unconstrained remainder of the board if no neighbor constrains it.
+ */
+void msw_ai_probabilities(msw *game, double *out)
+{
+	struct msw_loc loc, neigh;
+	int iter, unknown = 0, remaining = game->mines - game->flags;
+	int flagged, hidden;
+	double density;
+	char val, neighval;
+
+	for_each_row_col(game, loc)
+	{
+		val = msw_get_visible(game, loc);
+		out[msw_index(game, loc.row, loc.col)] =
+			(val == MSW_FLAG || val == MSW_MINE) ? 1.0 : 0.0;
+		if (val == MSW_UNKNOWN) {
+			out[msw_index(game, loc.row, loc.col)] = -1.0;
+			unknown++;
+		}
+	}
+	density = unknown ? (double)remaining / unknown : 0.0;
+
+	for_each_row_col(game, loc)
+	{
+		val = msw_get_visible(game, loc);
+		if (val < '1' || val > '8')
+			continue;
+		flagged = hidden = 0;
+		for_each_neigh(game, neigh, &loc, iter)
+		{
+			neighval = msw_get_visible(game, neigh);
+			if (neighval == MSW_FLAG)
+				flagged++;
+			else if (neighval == MSW_UNKNOWN)
+				hidden++;
+		}
+		if (!hidden)
+			continue;
+		double p = (double)(val - '0' - flagged) / hidden;
+		if (p < 0.0)
+			p = 0.0;
+		for_each_neigh(game, neigh, &loc, iter)
+		{
+			double *cell = &out[msw_index(game, neigh.row, neigh.col)];
+			if (msw_get_visible(game, neigh) != MSW_UNKNOWN ||
+			    *cell == 0.0)
+				continue; /* revealed, or already known safe */
+			if (p == 0.0 || p > *cell)
+				*cell = p;
+		}
+	}
+
+	for (int i = 0; i < game->rows * game->columns; i++)
+		if (out[i] < 0.0)
+			out[i] = density;
+}
+
+/*
+ * The standard sizes, each of which gets an engine of its own.
+ */
+#define MSW_GEOMETRIES(X) \
+	X(9x9, 9, 9)     /* beginner */ \
+	X(16x16, 16, 16) /* intermediate */ \
+	X(16x30, 16, 30) /* expert */
+
+/*
+ * Compile the hot paths into an engine, msw_engine_NAME, for boards of R rows
+ * and C columns (which may be taken from the game).
+ */
+#define MSW_ENGINE(NAME, R, C) \
+static void msw_count_mines_##NAME(msw *game) \
+{ \
+	msw_count_mines_in(game, R, C); \
+} \
+static void msw_label_regions_##NAME(msw *game) \
+{ \
+	msw_label_regions_in(game, R, C); \
+} \
+static int msw_dig_cell_##NAME(msw *game, struct msw_loc loc) \
+{ \
+	return msw_dig_cell_in(game, loc, C); \
+} \
+static int msw_reveal_cell_##NAME(msw *game, int r, int c) \
+{ \
+	return msw_reveal_cell_in(game, r, c, R, C, msw_dig_cell_##NAME); \
+} \
+static struct msw_ai_move msw_ai_fill_##NAME(msw *game) \
+{ \
+	return msw_ai_fill_in(game, R, C); \
+} \
+static const struct msw_engine msw_engine_##NAME = { \
+	.count_mines = msw_count_mines_##NAME, \
+	.label_regions = msw_label_regions_##NAME, \
+	.dig_cell = msw_dig_cell_##NAME, \
+	.reveal_cell = msw_reveal_cell_##NAME, \
+	.ai_fill = msw_ai_fill_##NAME, \
+};
+
+MSW_ENGINE(any, game->rows, game->columns)
+MSW_GEOMETRIES(MSW_ENGINE)
+
+static const struct msw_engine *msw_engine_for(int rows, int columns)
+{
+#define MSW_ENGINE_MATCH(NAME, R, C) \
+	if (rows == R && columns == C) \
+		return &msw_engine_##NAME;
+	MSW_GEOMETRIES(MSW_ENGINE_MATCH)
+#undef MSW_ENGINE_MATCH
+	return &msw_engine_any;
+}
+
+/**
+ * @brief Use the engine for any size of board, even on a standard size.
+ * @param game The game.
+ * @param generic Nonzero for the generic engine, or zero for the one
+ * msw_init() picked, which is the default.
+ *
+ * The two behave exactly alike, so this is only needed to compare them.
+ */
+void msw_set_generic(msw *game, int generic)
+{
+	game->engine = generic ? &msw_engine_any :
+	               msw_engine_for(game->rows, game->columns);
+}
@@ -13,6 +13,9 @@
 #ifndef MINESWEEPER_H
 #define MINESWEEPER_H
 
+#include <stdint.h>
+#include <stdio.h>
+
 /*
   Characters for each cell in minesweeper.
  */
@@ -21,6 +24,25 @@
 #define MSW_FLAG    'F'
 #define MSW_UNKNOWN '#'
 
+/*
+  A game stores each cell in one byte: its visible state in the high nibble and
+  the grid under it in the low nibble, as codes rather than the characters
+  above.  Numbers and mines have the same code in both halves, so a cell is
+  uncovered exactly when its halves are equal.  Characters are only produced
+  at the edges, through msw_get_visible(), msw_get_grid() and msw_vcell().
+ */
+#define MSW_CCLEAR   0 /* 1-8 are the other numbers */
+#define MSW_CMINE    9
+#define MSW_CUNKNOWN 10
+#define MSW_CFLAG    11
+
+#define MSW_CELL(vis, grid) ((vis) << 4 | (grid))
+#define MSW_CELL_VIS(cell) ((cell) >> 4)
+#define MSW_CELL_GRID(cell) ((cell) & 0xF)
+
+/* The character of each code. */
+extern const char msw_chars[16];
+
 /*
   Messages for user interface.
  */
@@ -37,29 +59,73 @@ extern const char *MSW_MSG[];
 #define MSW_MUNFLAGERR 8
 #define MSW_MWIN 9
 #define MSW_MNOUNDO 10
-#define MSW_MENDUNDO 10
+#define MSW_MENDUNDO 11
+#define MSW_MNOREDO 12
 
 /* Macro to determine if the game can continue after a move. */
 #define MSW_MOK(x) ((x) != MSW_MBOOM)
 
-#define msw_vcell(pgame, r, c) (pgame)->visible[(r) * (pgame)->columns + (c)]
+#define msw_vcell(pgame, r, c) \
+	msw_chars[MSW_CELL_VIS((pgame)->cells[(r) * (pgame)->columns + (c)])]
 
 struct msw_undo_entry;
+struct msw_replay;
+struct msw_change;
+struct msw_stats;
+struct msw_engine;
 
 /* Game object. */
 typedef struct msw {
 
-  char *grid;
-  char *visible;
-  char rows;
-  char columns;
-  char mines;
+  unsigned char *cells; /* see MSW_CELL() */
+  int has_grid;         /* whether the mines have been placed */
+  int rows;
+  int columns;
+  int mines;
   int flags;
 
+  /* Seed used for generating the grid (0 means pick one at first dig). */
+  uint64_t seed;
+  uint64_t rng;
+
+  /* Zobrist hash of the visible board (see msw_hash()). */
+  uint64_t hash;
+
+  /* Openings of the grid, labeled the first time they are needed: the
+     opening of each clear cell (negative for other cells), and the cells of
+     opening i, which are regioncells from index regionstart[i] up to
+     regionstart[i + 1]. The lists only ever grow, so relabeling a new grid
+     reuses them. */
+  int *region;
+  int nregions;
+  int labeled; /* zero until the grid's openings are labeled */
+  int *regionstart, *regioncells;
+  int startcap, cellscap;
+  int bbbv; /* see msw_3bv() */
+  int *islands; /* stack for flooding islands in msw_metrics(), if used */
+
   void *ai;
+  struct msw_replay *replay; /* open recording, if any */
   struct msw_undo_entry *undo;
   int gen;
   int undoidx, undocap;
+  int undoend; /* one past the last entry which may be redone */
+
+  /* Visible cells changed since the last msw_end_turn(), if tracked. */
+  struct msw_change *changes;
+  int nchanges, changecap;
+  void (*on_change)(struct msw *game, const struct msw_change *change,
+                    void *arg);
+  void *change_arg;
+
+  /* Counters and latencies, if enabled (see msw_stats_enable()). */
+  struct msw_stats *stats;
+
+  /* Threads which may uncover a giant opening (see msw_set_flood_threads()). */
+  int flood_threads;
+
+  /* Hot paths compiled for this size of board (see msw_set_generic()). */
+  const struct msw_engine *engine;
 
 } msw;
 
@@ -68,13 +134,38 @@ struct msw_loc {
 	int col;
 };
 
+/* A change to a visible cell, reported by msw_changes() or a callback. */
+struct msw_change {
+	struct msw_loc loc;
+	char old;
+	char new;
+};
+
+typedef void (*msw_change_fn)(msw *game, const struct msw_change *change,
+                              void *arg);
+
+/* Largest undo log a saved game or a recording may ask for. */
+#define MSW_UNDO_MAX (1 << 16)
+
 struct msw_undo_entry {
 	struct msw_loc loc;
 	int gen;
 	char old;
+	char new;
 };
 
 
+/* Actions in a recorded game. */
+enum msw_action {
+	MSW_ADIG,
+	MSW_AFLAG,
+	MSW_AUNFLAG,
+	MSW_AREVEAL,
+	MSW_AUNDO,
+	MSW_AREDO,
+	MSW_AENDTURN,
+};
+
 enum msw_ai_action {
 	AI_NONE,
 	AI_DIG,
@@ -88,6 +179,134 @@ struct msw_ai_move {
 	struct msw_loc loc;
 };
 
+/* Stages of the anytime solver, cheapest first. */
+enum msw_ai_stage {
+	MSW_AI_SIMPLE, /* a single number and its neighbors */
+	MSW_AI_GROUPS, /* one number's unknowns containing another's */
+	MSW_AI_CSP,    /* every consistent layout of the frontier */
+	MSW_AI_SAMPLE, /* the best guess in boards sampled from those layouts */
+	MSW_AI_GUESS,  /* the unknown cell least likely to be a mine */
+	MSW_AI_NSTAGES,
+};
+
+/* Limits on the work msw_ai_anytime() may do. Zero means no limit. */
+struct msw_ai_budget {
+	double seconds;
+	long nodes;       /* layouts of single cells tried by the CSP stage */
+	const int *cancel; /* stop once nonzero; set it with __atomic_store_n */
+	long samples;     /* boards to sample when guessing (0 to not sample) */
+	int threads;      /* threads to sample on */
+};
+
+/* What msw_ai_anytime() did. */
+struct msw_ai_report {
+	double confidence; /* probability that the move is safe */
+	int stage;         /* the stage which produced the move */
+	int complete;      /* zero if the budget ran out */
+	long nodes;        /* CSP nodes used */
+	long answered[MSW_AI_NSTAGES]; /* moves from each stage, over all calls */
+};
+
+/* Largest board msw_exact() works on. */
+#define MSW_EXACT_MAX_CELLS 128
+
+/* Settings for msw_exact(). Zero means the default (no time limit). */
+struct msw_exact_options {
+	double seconds;
+	size_t memory;    /* bytes for remembered positions */
+	long layouts;     /* most layouts of cells next to revealed ones */
+	int threads;
+	const struct msw_loc *first; /* if set, the value of digging this cell */
+};
+
+/* What msw_exact() found. */
+struct msw_exact_report {
+	double win;           /* chance of winning with best play */
+	struct msw_loc best;  /* a best dig, or -1, -1 if the game is won */
+	long layouts;         /* layouts of cells next to revealed ones */
+	long nodes, hits, evictions; /* positions searched, remembered, forgotten */
+};
+
+/* How hard a board is, from msw_metrics(). */
+struct msw_metrics {
+	int bbbv;     /* fewest clicks to clear the board (see msw_3bv()) */
+	int openings; /* groups of clear cells, each revealed by one dig */
+	int islands;  /* groups of numbers which no opening reveals */
+};
+
+/* Cells of a board in each visible state, from msw_count(). */
+struct msw_counts {
+	long revealed; /* uncovered numbers */
+	long flagged;
+	long unknown;
+};
+
+/* Kernels for whole-board scans (see msw_simd_select()). */
+enum msw_simd {
+	MSW_SIMD_SCALAR,
+	MSW_SIMD_SSE2,
+	MSW_SIMD_AVX2,
+};
+
+/* Side of the tiles of a msw_tiled board (a power of two). */
+#define MSW_TILE_BITS 6
+#define MSW_TILE (1 << MSW_TILE_BITS)
+
+/* Limits of msw_tiled_init(). Below the least density, openings may not end. */
+#define MSW_TILED_MAX ((int64_t)1 << 62)
+#define MSW_TILED_MIN_DENSITY 0.1
+
+struct msw_tile;
+
+/* A board too big to allocate, of which only the tiles played on exist (see
+   tiled.c). */
+typedef struct msw_tiled {
+	int64_t rows, columns;
+	uint64_t seed;
+	uint64_t threshold; /* cells whose hash is below this are mines */
+	int64_t first_row, first_col; /* the first dig, or -1 before it */
+	int64_t uncovered, flags;
+	struct msw_tile **tiles; /* hash table of tiles, by position */
+	size_t ntiles, tilecap;
+	int64_t *stack;          /* cells left to visit in an opening */
+	size_t stackcap;
+} msw_tiled;
+
+/* Public calls whose latencies are kept in a struct msw_stats. */
+enum msw_stats_call {
+	MSW_CALL_DIG,
+	MSW_CALL_FLAG,
+	MSW_CALL_UNFLAG,
+	MSW_CALL_REVEAL,
+	MSW_CALL_UNDO,
+	MSW_CALL_REDO,
+	MSW_CALL_WON,
+	MSW_CALL_AI,
+	MSW_CALL_ANYTIME,
+	MSW_NCALLS,
+};
+
+/* Histograms have a bucket for 0 and for each power of two after it. */
+#define MSW_STATS_BUCKETS 32
+
+struct msw_latency {
+	uint64_t calls;
+	uint64_t total_ns, max_ns;
+	uint64_t buckets[MSW_STATS_BUCKETS]; /* calls by nanoseconds taken */
+};
+
+/* What a game did while its statistics were enabled. */
+struct msw_stats {
+	uint64_t digs, uncovered;   /* digs, and the cells they uncovered */
+	uint64_t floods, flooded;   /* digs which opened an opening, and cells */
+	uint64_t dig_sizes[MSW_STATS_BUCKETS];   /* digs by cells uncovered */
+	uint64_t flood_sizes[MSW_STATS_BUCKETS]; /* openings by cells opened */
+	uint64_t ai_stage[MSW_AI_NSTAGES]; /* passes of each AI stage */
+	uint64_t marks;        /* marks on unknown cells made by the AI */
+	uint64_t undo_entries; /* entries written to the undo log */
+	struct msw_latency calls[MSW_NCALLS];
+};
+
 
 /* Construction/destruction. */
 void msw_init(msw *obj, int rows, int columns, int mines);
@@ -95,11 +314,110 @@ msw *msw_create(int rows, int columns, int mines);
 void msw_destroy(msw *obj);
 void msw_delete(msw *obj);
 void msw_enable_undo_logging(msw *obj, int cap);
+void msw_set_seed(msw *obj, uint64_t seed);
+uint64_t msw_get_seed(msw *obj);
+void msw_track_changes(msw *obj, int enable);
+void msw_set_change_callback(msw *obj, msw_change_fn fn, void *arg);
+const struct msw_change *msw_changes(msw *obj, int *count);
+void msw_set_generic(msw *game, int generic);
+void *msw_calloc(size_t n, size_t size);
+
+/* Grid generation. */
+void msw_generate_grid(msw *obj);
+void msw_number_grid(msw *obj);
+void msw_new_grid(msw *obj);
+void msw_load_mines(msw *obj, const unsigned char *mines);
+void msw_reset(msw *obj);
+
+/* Serialization. */
+size_t msw_serialize(msw *game, unsigned char *buf, size_t len);
+int msw_deserialize(msw *game, const unsigned char *buf, size_t len);
+
+/* Board corpus files. */
+struct msw_corpus {
+	int rows, columns, mines;
+	uint64_t count;
+	uint64_t seed;
+	size_t stride;
+	const unsigned char *base;
+	size_t size;
+};
+
+int msw_corpus_open(struct msw_corpus *corpus, const char *path);
+void msw_corpus_close(struct msw_corpus *corpus);
+int msw_corpus_load(const struct msw_corpus *corpus, uint64_t i, msw *game,
+                    struct msw_loc *start);
+int msw_corpus_write(const char *path, int rows, int columns, int mines,
+                     uint64_t seed, uint64_t count);
+int msw_corpus_write_seeds(const char *path, int rows, int columns, int mines,
+                           const uint64_t *seeds, uint64_t count);
+
+/* Recording and replaying games. */
+int msw_record(msw *game, const char *path, int timestamps);
+void msw_record_stop(msw *game);
+void msw_replay_record(msw *game, int action, int row, int col, int status);
 
 /* Utilities. */
 int msw_in_bounds(msw *game, int row, int column);
 int msw_index(msw *game, int row, int column);
+uint64_t msw_hash(msw *game);
+int msw_3bv(msw *game);
+int msw_metrics(msw *game, struct msw_metrics *metrics);
+
+/* Whole-board scans. */
+int msw_scan_won(msw *game);
+void msw_count(msw *game, struct msw_counts *counts);
+long msw_diff(msw *a, msw *b, int *cells, long max);
+int msw_simd_select(int level);
+
+/* Uncovering giant openings on several threads. */
+void msw_set_flood_threads(msw *game, int threads);
+long msw_flood(msw *game, const int *cell, const int *end);
+
+/* Tiled boards. */
+int msw_tiled_init(msw_tiled *b, int64_t rows, int64_t columns,
+                   double density, uint64_t seed);
+void msw_tiled_destroy(msw_tiled *b);
+char msw_tiled_get(msw_tiled *b, int64_t r, int64_t c);
+int msw_tiled_dig(msw_tiled *b, int64_t r, int64_t c);
+int msw_tiled_flag(msw_tiled *b, int64_t r, int64_t c);
+int msw_tiled_unflag(msw_tiled *b, int64_t r, int64_t c);
+int msw_tiled_reveal(msw_tiled *b, int64_t r, int64_t c);
+size_t msw_tiled_memory(msw_tiled *b);
+void msw_tiled_print(msw_tiled *b, int64_t row, int64_t col, int64_t rows,
+                     int64_t cols, FILE *stream);
+
+/* Statistics. */
+void msw_stats_enable(msw *game, int enable);
+const struct msw_stats *msw_stats_get(msw *game);
+void msw_stats_reset(msw *game);
+void msw_stats_add(struct msw_stats *to, const struct msw_stats *from);
+void msw_stats_print(const struct msw_stats *stats, FILE *stream);
+uint64_t msw_stats_clock(void);
+uint64_t msw_stats_deadline(double seconds);
+void msw_stats_call(struct msw_stats *stats, int call, uint64_t start);
+void msw_stats_dig(struct msw_stats *stats, int n, int flood);
+
+/*
+ * Tracing, compiled in with -DMSW_TRACE.  Spans are named by string literals,
+ * and may carry a count which isn't negative:
+ *   msw_trace_begin("csp component", size);
+ *   ...
+ *   msw_trace_end("csp component");
+ */
+#ifdef MSW_TRACE
+void msw_trace_event(const char *name, int phase, long arg);
+#define msw_trace_begin(name, arg) msw_trace_event(name, 'B', arg)
+#define msw_trace_end(name) msw_trace_event(name, 'E', -1)
+#else
+#define msw_trace_begin(name, arg) ((void)0)
+#define msw_trace_end(name) ((void)0)
+#endif
+int msw_trace_dump(const char *path);
+void msw_trace_dump_at_exit(const char *path);
+uint64_t msw_hash_cell(int index, char state);
 void msw_print(msw *game, FILE *stream);
+void msw_visible_chars(msw *game, char *out);
 
 /* Game actions. */
 int msw_dig(msw *game, int row, int column);
@@ -108,23 +426,54 @@ int msw_unflag(msw *game, int r, int c);
 int msw_reveal(msw *game, int r, int c);
 void msw_end_turn(msw *game);
 int msw_undo(msw *game);
+int msw_redo(msw *game);
 int msw_won(msw *game);
 struct msw_ai_move msw_ai(msw *game);
+struct msw_ai_move msw_ai_deduce(msw *game, int *stage);
+struct msw_ai_move msw_ai_anytime(msw *game, const struct msw_ai_budget *budget,
+                                  struct msw_ai_report *report);
+int msw_ai_apply(msw *game, struct msw_ai_move move);
+void msw_ai_probabilities(msw *game, double *out);
+int msw_exact(msw *game, const struct msw_exact_options *options,
+              struct msw_exact_report *report);
+
+/* Working out hints on a background thread. */
+struct msw_aiworker;
+
+struct msw_aiworker *msw_aiworker_create(void (*ready)(void *arg), void *arg);
+void msw_aiworker_destroy(struct msw_aiworker *w);
+void msw_aiworker_submit(struct msw_aiworker *w, msw *game);
+void msw_aiworker_cancel(struct msw_aiworker *w);
+int msw_aiworker_poll(struct msw_aiworker *w, struct msw_ai_move *move);
+struct msw_ai_move msw_aiworker_wait(struct msw_aiworker *w);
 
 /* UI's */
 int gui_main(int argc, char **argv);
 int cli_main(int argc, char **argv);
 int curses_main(int argc, char **argv);
+int gen_corpus_main(int argc, char **argv);
+int replay_main(int argc, char **argv);
+int exact_main(int argc, char **argv);
+int analyze_main(int argc, char **argv);
+int tiled_main(int argc, char **argv);
+
+/*
+ * Define all eight neighbors for a cell.  The array rnbr is the offset from the
+ * row for each neighbor, and the array cnbr is the offset from the column for
+ * each neighbor.
+ */
+#define NUM_NEIGHBORS 8
+static const char rnbr[NUM_NEIGHBORS] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+static const char cnbr[NUM_NEIGHBORS] = { -1, 0, 1, -1, 1, -1, 0, 1 };
 
 #define for_each_row_col(pgame, LVAR) \
 	for (LVAR.row = 0; LVAR.row < (pgame)->rows; LVAR.row++) \
 		for (LVAR.col = 0; LVAR.col < (pgame)->columns; LVAR.col++)
 
 #define for_each_neigh(game, NEIGHVAR, PLOC, IVAR) \
-	for (NEIGHVAR = (struct msw_loc){.row=(PLOC)->row + rnbr[0], .col=(PLOC)->col + cnbr[0]}, IVAR = 0; \
-	     IVAR < NUM_NEIGHBORS; \
-	     IVAR++, NEIGHVAR = (struct msw_loc){.row=(PLOC)->row + rnbr[IVAR], .col=(PLOC)->col + cnbr[IVAR]}) \
-	     if (msw_inbound(game, NEIGHVAR))
+	for (IVAR = 0; IVAR < NUM_NEIGHBORS; IVAR++) \
+		if (NEIGHVAR = (struct msw_loc){.row=(PLOC)->row + rnbr[IVAR], .col=(PLOC)->col + cnbr[IVAR]}, \
+		    msw_inbound(game, NEIGHVAR))
 
 static inline int msw_inbound(msw *game, struct msw_loc loc)
 {
@@ -132,14 +481,42 @@ static inline int msw_inbound(msw *game, struct msw_loc loc)
 	        loc.col < game->columns);
 }
 
+/*
+ * The code of a cell's character (see MSW_CELL()).
+ */
+static inline int msw_code(char c)
+{
+	return c >= '0' && c <= '8' ? c - '0' : c == MSW_MINE ? MSW_CMINE :
+	       c == MSW_FLAG ? MSW_CFLAG : MSW_CUNKNOWN;
+}
+
 static inline char msw_get_grid(msw *game, struct msw_loc loc)
 {
-	return game->grid[loc.row * game->columns + loc.col];
+	int idx = loc.row * game->columns + loc.col;
+	return msw_chars[MSW_CELL_GRID(game->cells[idx])];
 }
 
 static inline char msw_get_visible(msw *game, struct msw_loc loc)
 {
-	return game->visible[loc.row * game->columns + loc.col];
+	int idx = loc.row * game->columns + loc.col;
+	return msw_chars[MSW_CELL_VIS(game->cells[idx])];
+}
+
+/*
+ * Time a public call, if statistics are enabled:
+ *   uint64_t start = msw_stats_begin(game);
+ *   ...
+ *   msw_stats_end(game, MSW_CALL_DIG, start);
+ */
+static inline uint64_t msw_stats_begin(msw *game)
+{
+	return game->stats ? msw_stats_clock() : 0;
+}
+
+static inline void msw_stats_end(msw *game, int call, uint64_t start)
+{
+	if (game->stats)
+		msw_stats_call(game->stats, call, start);
 }
 
 #endif /* MINESWEEPER_H */
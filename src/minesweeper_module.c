@@ -24,14 +24,24 @@ static void Minesweeper_dealloc(Minesweeper *self)
   Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
-static int Minesweeper_init(Minesweeper *self, PyObject *args)
+static int Minesweeper_init(Minesweeper *self, PyObject *args, PyObject *kwds)
 {
+  static char *kwlist[] = {"rows", "columns", "mines", "seed", NULL};
   int rows = 0, columns = 0, mines = 0;
+  unsigned long long seed = 0;
 
-  if (!PyArg_ParseTuple(args, "iii", &rows, &columns, &mines))
-    return NULL;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "iii|K", kwlist,
+                                   &rows, &columns, &mines, &seed))
+    return -1;
+
+  if (rows <= 0 || columns <= 0 || mines < 0 || mines >= rows * columns) {
+    PyErr_SetString(PyExc_ValueError, "bad board geometry");
+    return -1;
+  }
 
+  msw_destroy(&self->ob_game);
   msw_init(&self->ob_game, rows, columns, mines);
+  msw_set_seed(&self->ob_game, seed);
   return 0;
 }
 
@@ -102,6 +112,310 @@ static PyObject *Minesweeper_won(Minesweeper *self, PyObject *args)
   return PyBool_FromLong(rv);
 }
 
+static PyObject *Minesweeper_hash(Minesweeper *self)
+{
+  return PyLong_FromUnsignedLongLong(msw_hash(&self->ob_game));
+}
+
+static PyObject *Minesweeper_3bv(Minesweeper *self)
+{
+  return PyLong_FromLong(msw_3bv(&self->ob_game));
+}
+
+static PyObject *Minesweeper_metrics(Minesweeper *self)
+{
+  struct msw_metrics m;
+
+  if (msw_metrics(&self->ob_game, &m) < 0)
+    Py_RETURN_NONE;
+  return Py_BuildValue("{s:i,s:i,s:i}", "bbbv", m.bbbv, "openings",
+                       m.openings, "islands", m.islands);
+}
+
+static PyObject *Minesweeper_cell(Minesweeper *self, PyObject *args)
+{
+  int row = 0, column = 0;
+  char cell;
+
+  if (!PyArg_ParseTuple(args, "ii", &row, &column))
+    return NULL;
+
+  if (!msw_in_bounds(&self->ob_game, row, column)) {
+    PyErr_SetString(PyExc_IndexError, "cell out of bounds");
+    return NULL;
+  }
+  cell = msw_vcell(&self->ob_game, row, column);
+  return PyUnicode_FromStringAndSize(&cell, 1);
+}
+
+static PyObject *Minesweeper_visible(Minesweeper *self)
+{
+  msw *game = &self->ob_game;
+  PyObject *bytes;
+
+  bytes = PyBytes_FromStringAndSize(NULL, game->rows * game->columns);
+  if (bytes == NULL)
+    return NULL;
+  msw_visible_chars(game, PyBytes_AS_STRING(bytes));
+  return bytes;
+}
+
+static PyObject *Minesweeper_counts(Minesweeper *self)
+{
+  struct msw_counts counts;
+
+  msw_count(&self->ob_game, &counts);
+  return Py_BuildValue("(lll)", counts.revealed, counts.flagged,
+                       counts.unknown);
+}
+
+static PyTypeObject minesweeper_MinesweeperType;
+
+static PyObject *Minesweeper_diff(Minesweeper *self, PyObject *args)
+{
+  Minesweeper *other;
+  PyObject *list, *item;
+  long i, n;
+  int *cells;
+
+  if (!PyArg_ParseTuple(args, "O!", &minesweeper_MinesweeperType, &other))
+    return NULL;
+  n = msw_diff(&self->ob_game, &other->ob_game, NULL, 0);
+  if (n < 0) {
+    PyErr_SetString(PyExc_ValueError, "boards are different sizes");
+    return NULL;
+  }
+  cells = PyMem_Malloc((n ? n : 1) * sizeof(int));
+  if (cells == NULL)
+    return PyErr_NoMemory();
+  msw_diff(&self->ob_game, &other->ob_game, cells, n);
+  list = PyList_New(n);
+  for (i = 0; list != NULL && i < n; i++) {
+    item = Py_BuildValue("(ii)", cells[i] / self->ob_game.columns,
+                         cells[i] % self->ob_game.columns);
+    if (item == NULL) {
+      Py_CLEAR(list);
+      break;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  PyMem_Free(cells);
+  return list;
+}
+
+static PyObject *Minesweeper_enable_undo(Minesweeper *self, PyObject *args)
+{
+  int cap = 4096;
+
+  if (!PyArg_ParseTuple(args, "|i", &cap))
+    return NULL;
+
+  if (cap < 2 || cap > MSW_UNDO_MAX) {
+    PyErr_Format(PyExc_ValueError, "undo capacity must be from 2 to %d",
+                 MSW_UNDO_MAX);
+    return NULL;
+  }
+  msw_enable_undo_logging(&self->ob_game, cap);
+  Py_RETURN_NONE;
+}
+
+static PyObject *Minesweeper_undo(Minesweeper *self)
+{
+  return PyLong_FromLong(msw_undo(&self->ob_game));
+}
+
+static PyObject *Minesweeper_redo(Minesweeper *self)
+{
+  return PyLong_FromLong(msw_redo(&self->ob_game));
+}
+
+static PyObject *Minesweeper_end_turn(Minesweeper *self)
+{
+  msw_end_turn(&self->ob_game);
+  Py_RETURN_NONE;
+}
+
+static PyObject *Minesweeper_track_changes(Minesweeper *self, PyObject *args)
+{
+  int enable = 1;
+
+  if (!PyArg_ParseTuple(args, "|p", &enable))
+    return NULL;
+
+  msw_track_changes(&self->ob_game, enable);
+  Py_RETURN_NONE;
+}
+
+static PyObject *Minesweeper_changes(Minesweeper *self)
+{
+  const struct msw_change *changes;
+  PyObject *list, *item;
+  int i, count;
+
+  changes = msw_changes(&self->ob_game, &count);
+  list = PyList_New(count);
+  if (list == NULL)
+    return NULL;
+  for (i = 0; i < count; i++) {
+    item = Py_BuildValue("(iiCC)", changes[i].loc.row, changes[i].loc.col,
+                         changes[i].old, changes[i].new);
+    if (item == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  return list;
+}
+
+static PyObject *Minesweeper_ai(Minesweeper *self)
+{
+  struct msw_ai_move move = msw_ai(&self->ob_game);
+  return Py_BuildValue("(iiis)", move.action, move.loc.row, move.loc.col,
+                       move.description);
+}
+
+static PyObject *Minesweeper_ai_anytime(Minesweeper *self, PyObject *args,
+                                        PyObject *kwds)
+{
+  static char *kwlist[] = {"seconds", "nodes", "samples", "threads", NULL};
+  struct msw_ai_budget budget = { 0 };
+  struct msw_ai_report report = { 0 };
+  struct msw_ai_move move;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|dlli", kwlist,
+                                   &budget.seconds, &budget.nodes,
+                                   &budget.samples, &budget.threads))
+    return NULL;
+  move = msw_ai_anytime(&self->ob_game, &budget, &report);
+  return Py_BuildValue("(iiidiO)", move.action, move.loc.row, move.loc.col,
+                       report.confidence, report.stage,
+                       report.complete ? Py_True : Py_False);
+}
+
+static PyObject *Minesweeper_ai_play(Minesweeper *self, PyObject *args)
+{
+  msw *game = &self->ob_game;
+  struct msw_ai_move move;
+  PyObject *moves, *item;
+  int limit = -1, status = MSW_MMOVE;
+
+  if (!PyArg_ParseTuple(args, "|i", &limit))
+    return NULL;
+
+  moves = PyList_New(0);
+  if (moves == NULL)
+    return NULL;
+
+  while (limit != 0 && MSW_MOK(status) && !msw_won(game)) {
+    move = msw_ai(game);
+    if (move.action == AI_NONE)
+      break;
+    status = msw_ai_apply(game, move);
+    msw_end_turn(game);
+    item = Py_BuildValue("(iii)", move.action, move.loc.row, move.loc.col);
+    if (item == NULL || PyList_Append(moves, item) < 0) {
+      Py_XDECREF(item);
+      Py_DECREF(moves);
+      return NULL;
+    }
+    Py_DECREF(item);
+    if (limit > 0)
+      limit--;
+  }
+  if (MSW_MOK(status) && msw_won(game))
+    status = MSW_MWIN;
+  return Py_BuildValue("(iN)", status, moves);
+}
+
+static PyObject *Minesweeper_exact(Minesweeper *self, PyObject *args,
+                                   PyObject *kwds)
+{
+  static char *kwlist[] = {"seconds", "threads", "memory", "row", "col", NULL};
+  struct msw_exact_options options = { 0 };
+  struct msw_exact_report report;
+  struct msw_loc first = { -1, -1 };
+  Py_ssize_t memory = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|dinii", kwlist,
+                                   &options.seconds, &options.threads,
+                                   &memory, &first.row, &first.col))
+    return NULL;
+  options.memory = memory;
+  if (first.row >= 0 || first.col >= 0) {
+    if (!msw_in_bounds(&self->ob_game, first.row, first.col)) {
+      PyErr_SetString(PyExc_ValueError, "cell is off the board");
+      return NULL;
+    }
+    options.first = &first;
+  }
+  if (msw_exact(&self->ob_game, &options, &report) < 0)
+    Py_RETURN_NONE;
+  return Py_BuildValue("(dii)", report.win, report.best.row, report.best.col);
+}
+
+static PyObject *Minesweeper_probabilities(Minesweeper *self)
+{
+  msw *game = &self->ob_game;
+  PyObject *buf, *view, *rv;
+
+  buf = PyByteArray_FromStringAndSize(NULL,
+      sizeof(double) * game->rows * game->columns);
+  if (buf == NULL)
+    return NULL;
+  msw_ai_probabilities(game, (double *)PyByteArray_AS_STRING(buf));
+
+  view = PyMemoryView_FromObject(buf);
+  Py_DECREF(buf);
+  if (view == NULL)
+    return NULL;
+  rv = PyObject_CallMethod(view, "cast", "s", "d");
+  Py_DECREF(view);
+  return rv;
+}
+
+static PyObject *Minesweeper_getstate(Minesweeper *self)
+{
+  PyObject *state;
+  size_t len = msw_serialize(&self->ob_game, NULL, 0);
+
+  state = PyBytes_FromStringAndSize(NULL, len);
+  if (state == NULL)
+    return NULL;
+  msw_serialize(&self->ob_game, (unsigned char *)PyBytes_AS_STRING(state), len);
+  return state;
+}
+
+static PyObject *Minesweeper_setstate(Minesweeper *self, PyObject *state)
+{
+  Py_buffer view;
+  msw game;
+
+  if (PyObject_GetBuffer(state, &view, PyBUF_SIMPLE) < 0)
+    return NULL;
+  if (msw_deserialize(&game, view.buf, view.len) < 0) {
+    PyBuffer_Release(&view);
+    PyErr_SetString(PyExc_ValueError, "malformed game state");
+    return NULL;
+  }
+  PyBuffer_Release(&view);
+
+  msw_destroy(&self->ob_game);
+  self->ob_game = game;
+  Py_RETURN_NONE;
+}
+
+static PyObject *Minesweeper_reduce(Minesweeper *self)
+{
+  msw *game = &self->ob_game;
+  PyObject *state = Minesweeper_getstate(self);
+
+  if (state == NULL)
+    return NULL;
+  return Py_BuildValue("(O(iii)N)", Py_TYPE(self), game->rows, game->columns,
+                       game->mines, state);
+}
+
 /*******************************************************************************
 
                                Class Definitions
@@ -109,12 +423,16 @@ static PyObject *Minesweeper_won(Minesweeper *self, PyObject *args)
 *******************************************************************************/
 
 static PyMemberDef Minesweeper_members[] = {
-  {"rows", T_BYTE, offsetof(Minesweeper, ob_game) +
+  {"rows", T_INT, offsetof(Minesweeper, ob_game) +
    offsetof(msw, rows), READONLY, "rows in the game"},
-  {"columns", T_BYTE, offsetof(Minesweeper, ob_game) +
+  {"columns", T_INT, offsetof(Minesweeper, ob_game) +
    offsetof(msw, columns), READONLY, "columns in the game"},
-  {"mines", T_BYTE, offsetof(Minesweeper, ob_game) +
+  {"mines", T_INT, offsetof(Minesweeper, ob_game) +
    offsetof(msw, mines), READONLY, "mines in the game"},
+  {"flags", T_INT, offsetof(Minesweeper, ob_game) +
+   offsetof(msw, flags), READONLY, "flags placed in the game"},
+  {"seed", T_ULONGLONG, offsetof(Minesweeper, ob_game) +
+   offsetof(msw, seed), READONLY, "seed of the grid (0 until first dig)"},
   {NULL} // sentinel
 };
 
@@ -133,6 +451,57 @@ static PyMethodDef Minesweeper_methods[] = {
    "Reveal at a given cell."},
   {"won", (PyCFunction)Minesweeper_won, METH_NOARGS,
    "Return True if the game is won."},
+  {"hash", (PyCFunction)Minesweeper_hash, METH_NOARGS,
+   "Return a 64-bit hash of the visible board."},
+  {"bbbv", (PyCFunction)Minesweeper_3bv, METH_NOARGS,
+   "Return the board's 3BV (fewest clicks to clear it), or -1 before the "
+   "first dig."},
+  {"metrics", (PyCFunction)Minesweeper_metrics, METH_NOARGS,
+   "Return a dict of the board's 3BV, openings and islands, or None before "
+   "the first dig."},
+  {"cell", (PyCFunction)Minesweeper_cell, METH_VARARGS,
+   "Return the visible character of a given cell."},
+  {"visible", (PyCFunction)Minesweeper_visible, METH_NOARGS,
+   "Return the visible board as bytes, in row-major order."},
+  {"counts", (PyCFunction)Minesweeper_counts, METH_NOARGS,
+   "Return (uncovered, flagged, unknown): the visible cells of each kind."},
+  {"diff", (PyCFunction)Minesweeper_diff, METH_VARARGS,
+   "Return the (row, col) of each cell whose visible state differs from\n"
+   "another game's, of the same size."},
+  {"enable_undo", (PyCFunction)Minesweeper_enable_undo, METH_VARARGS,
+   "Start logging moves for undo, with an optional log capacity."},
+  {"undo", (PyCFunction)Minesweeper_undo, METH_NOARGS,
+   "Undo the last turn."},
+  {"redo", (PyCFunction)Minesweeper_redo, METH_NOARGS,
+   "Redo the last undone turn."},
+  {"end_turn", (PyCFunction)Minesweeper_end_turn, METH_NOARGS,
+   "Mark the end of a turn (the unit of undo)."},
+  {"track_changes", (PyCFunction)Minesweeper_track_changes, METH_VARARGS,
+   "Start (or, given False, stop) collecting changed cells each turn."},
+  {"changes", (PyCFunction)Minesweeper_changes, METH_NOARGS,
+   "Return the (row, col, old, new) changes made since end_turn()."},
+  {"ai", (PyCFunction)Minesweeper_ai, METH_NOARGS,
+   "Return the AI's next move as (action, row, col, description)."},
+  {"ai_anytime", (PyCFunction)Minesweeper_ai_anytime,
+   METH_VARARGS | METH_KEYWORDS,
+   "Return the best move found within a budget (seconds=0, nodes=0 for no\n"
+   "limit), sampling boards to break ties between guesses (samples=0,\n"
+   "threads=1), as (action, row, col, confidence, stage, complete)."},
+  {"ai_play", (PyCFunction)Minesweeper_ai_play, METH_VARARGS,
+   "Play up to N AI moves (all if omitted), returning (status, moves)."},
+  {"exact", (PyCFunction)Minesweeper_exact, METH_VARARGS | METH_KEYWORDS,
+   "Return (win, row, col): the chance of winning with best play, and a\n"
+   "best dig; or with row and col, the chance after digging there first.\n"
+   "Boards of at most 128 cells only. Returns None if it can't be worked\n"
+   "out (seconds=0 for no limit, threads=1, memory=0 for the default)."},
+  {"probabilities", (PyCFunction)Minesweeper_probabilities, METH_NOARGS,
+   "Return estimated mine probabilities as a memoryview of doubles."},
+  {"__getstate__", (PyCFunction)Minesweeper_getstate, METH_NOARGS,
+   "Return the game serialized as bytes."},
+  {"__setstate__", (PyCFunction)Minesweeper_setstate, METH_O,
+   "Replace the game with one serialized by __getstate__."},
+  {"__reduce__", (PyCFunction)Minesweeper_reduce, METH_NOARGS,
+   "Support for pickling."},
   {NULL} // sentinel
 };
 
@@ -251,5 +620,19 @@ PyMODINIT_FUNC PyInit_minesweeper(void)
   PyModule_AddIntConstant(m, "BOOM", MSW_MBOOM);
   PyModule_AddIntConstant(m, "UNFLAGERR", MSW_MUNFLAGERR);
   PyModule_AddIntConstant(m, "WIN", MSW_MWIN);
+  PyModule_AddIntConstant(m, "NOUNDO", MSW_MNOUNDO);
+  PyModule_AddIntConstant(m, "ENDUNDO", MSW_MENDUNDO);
+  PyModule_AddIntConstant(m, "NOREDO", MSW_MNOREDO);
+
+  PyModule_AddIntConstant(m, "AI_NONE", AI_NONE);
+  PyModule_AddIntConstant(m, "AI_DIG", AI_DIG);
+  PyModule_AddIntConstant(m, "AI_REVEAL", AI_REVEAL);
+  PyModule_AddIntConstant(m, "AI_FLAG", AI_FLAG);
+
+  PyModule_AddIntConstant(m, "STAGE_SIMPLE", MSW_AI_SIMPLE);
+  PyModule_AddIntConstant(m, "STAGE_GROUPS", MSW_AI_GROUPS);
+  PyModule_AddIntConstant(m, "STAGE_CSP", MSW_AI_CSP);
+  PyModule_AddIntConstant(m, "STAGE_SAMPLE", MSW_AI_SAMPLE);
+  PyModule_AddIntConstant(m, "STAGE_GUESS", MSW_AI_GUESS);
   return m;
 }
@@ -0,0 +1,362 @@
+/***************************************************************************//**
+
+  @file         replay.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Recording games to a compact log, and replaying them.
+
+  A replay log is append-only, and may hold any number of games one after
+  another.  Each game is:
+
+      "MSWR" version:u8 flags:u8
+      rows:varint columns:varint mines:varint undocap:varint seed:u64
+      actions...
+      0x80
+
+  Each action is a byte holding the action (low 3 bits) and the status it
+  returned (next 4 bits).  Actions on a cell are followed by the zigzag varint
+  difference between this cell's row-major index and the previous one's.  If
+  flags & MSW_REPLAY_TIMES, every action ends with a varint count of
+  microseconds since the previous one.
+
+  Replaying compares each status with the recorded one, so a log of games is
+  also a regression test.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "encode.h"
+#include "minesweeper.h"
+
+#define MSW_REPLAY_MAGIC "MSWR"
+#define MSW_REPLAY_VERSION 1
+#define MSW_REPLAY_TIMES 0x01
+#define MSW_REPLAY_END 0x80
+
+struct msw_replay {
+	FILE *f;
+	int timestamps;
+	int64_t lastcell;
+	struct timespec last;
+};
+
+static int action_has_cell(int action)
+{
+	return action <= MSW_AREVEAL;
+}
+
+/**
+ * @brief Start recording a game to a file.
+ * @param game A game with no moves made yet.
+ * @param path Log file; games are appended to it.
+ * @param timestamps Nonzero to record the time between actions.
+ * @returns 0 on success, -1 on failure (with a message on stderr).
+ */
+int msw_record(msw *game, const char *path, int timestamps)
+{
+	struct msw_replay *rp;
+	unsigned char hdr[6 + 4 * MSW_VARINT_MAX + 8];
+	int n = 0;
+
+	if (game->has_grid) {
+		fprintf(stderr, "%s: can only record a game from the start\n", path);
+		return -1;
+	}
+	if (game->undo && game->undocap > MSW_UNDO_MAX) {
+		fprintf(stderr, "%s: undo log too big to record\n", path);
+		return -1;
+	}
+	msw_record_stop(game);
+
+	rp = calloc(1, sizeof(struct msw_replay));
+	if (rp == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	rp->f = fopen(path, "ab");
+	if (rp->f == NULL) {
+		perror(path);
+		free(rp);
+		return -1;
+	}
+	setvbuf(rp->f, NULL, _IOFBF, 1 << 16);
+	rp->timestamps = timestamps;
+	clock_gettime(CLOCK_MONOTONIC, &rp->last);
+
+	memcpy(hdr, MSW_REPLAY_MAGIC, 4);
+	n = 4;
+	hdr[n++] = MSW_REPLAY_VERSION;
+	hdr[n++] = timestamps ? MSW_REPLAY_TIMES : 0;
+	n += msw_put_varint(hdr + n, game->rows);
+	n += msw_put_varint(hdr + n, game->columns);
+	n += msw_put_varint(hdr + n, game->mines);
+	n += msw_put_varint(hdr + n, game->undo ? game->undocap : 0);
+	msw_put_le64(hdr + n, msw_get_seed(game));
+	n += 8;
+	fwrite(hdr, 1, n, rp->f);
+
+	game->replay = rp;
+	return 0;
+}
+
+/**
+ * @brief Finish the game's recording, if any, and close the log.
+ */
+void msw_record_stop(msw *game)
+{
+	struct msw_replay *rp = game->replay;
+
+	if (rp == NULL)
+		return;
+	fputc(MSW_REPLAY_END, rp->f);
+	fclose(rp->f);
+	free(rp);
+	game->replay = NULL;
+}
+
+/**
+ * @brief Append an action to the game's recording.
+ *
+ * Called by the game itself for every public action. Moves which were out of
+ * bounds changed nothing and are left out.
+ */
+void msw_replay_record(msw *game, int action, int row, int col, int status)
+{
+	struct msw_replay *rp = game->replay;
+	unsigned char buf[1 + 2 * MSW_VARINT_MAX];
+	struct timespec ts;
+	int64_t cell, usec;
+	int n = 0;
+
+	if (status == MSW_MBOUND)
+		return;
+
+	buf[n++] = action | status << 3;
+	if (action_has_cell(action)) {
+		cell = (int64_t)row * game->columns + col;
+		n += msw_put_varint(buf + n, msw_zigzag(cell - rp->lastcell));
+		rp->lastcell = cell;
+	}
+	if (rp->timestamps) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		usec = (ts.tv_sec - rp->last.tv_sec) * 1000000 +
+		       (ts.tv_nsec - rp->last.tv_nsec) / 1000;
+		n += msw_put_varint(buf + n, usec > 0 ? usec : 0);
+		rp->last = ts;
+	}
+	fwrite(buf, 1, n, rp->f);
+}
+
+struct replay_stats {
+	long games, moves, mismatches;
+	int verbose;
+	struct msw_stats *engine; /* totals of every game's, if kept */
+};
+
+/*
+ * Replay one game starting at *p. Returns -1 if the log is malformed.
+ */
+static int replay_game(const unsigned char **p, const unsigned char *end,
+                       struct replay_stats *st)
+{
+	const unsigned char *q = *p;
+	uint64_t rows, columns, mines, cap, seed;
+	int64_t cell = 0;
+	int err = 0, flags, action, expect, rv, last = MSW_MMOVE;
+	long moves = 0;
+	msw game;
+	struct msw_counts counts;
+
+	if (end - q < 6 || memcmp(q, MSW_REPLAY_MAGIC, 4) != 0 ||
+	    q[4] != MSW_REPLAY_VERSION)
+		return -1;
+	flags = q[5];
+	q += 6;
+	rows = msw_get_varint(&q, end, &err);
+	columns = msw_get_varint(&q, end, &err);
+	mines = msw_get_varint(&q, end, &err);
+	cap = msw_get_varint(&q, end, &err);
+	if (err || end - q < 8 || rows == 0 || columns == 0 ||
+	    rows > 0xFFFF || columns > 0xFFFF || rows * columns > 0x7FFFFFFF ||
+	    mines >= rows * columns || cap == 1 || cap > MSW_UNDO_MAX)
+		return -1;
+	seed = msw_get_le64(q);
+	q += 8;
+
+	msw_init(&game, rows, columns, mines);
+	msw_set_seed(&game, seed);
+	msw_stats_enable(&game, st->engine != NULL);
+	if (cap)
+		msw_enable_undo_logging(&game, cap);
+
+	while (q < end && *q != MSW_REPLAY_END) {
+		action = *q & 7;
+		expect = (*q++ >> 3) & 0xF;
+		if (expect > MSW_MNOREDO)
+			err = 1;
+		if (action_has_cell(action)) {
+			cell += msw_unzigzag(msw_get_varint(&q, end, &err));
+			if (cell < 0 || cell >= (int64_t)(rows * columns))
+				err = 1;
+		}
+		if (flags & MSW_REPLAY_TIMES)
+			msw_get_varint(&q, end, &err); /* only for analysis */
+		if (err)
+			break;
+		switch (action) {
+		case MSW_ADIG:
+			rv = msw_dig(&game, cell / columns, cell % columns);
+			break;
+		case MSW_AFLAG:
+			rv = msw_flag(&game, cell / columns, cell % columns);
+			break;
+		case MSW_AUNFLAG:
+			rv = msw_unflag(&game, cell / columns, cell % columns);
+			break;
+		case MSW_AREVEAL:
+			rv = msw_reveal(&game, cell / columns, cell % columns);
+			break;
+		case MSW_AUNDO:
+			rv = msw_undo(&game);
+			break;
+		case MSW_AREDO:
+			rv = msw_redo(&game);
+			break;
+		case MSW_AENDTURN:
+			msw_end_turn(&game);
+			rv = MSW_MMOVE;
+			break;
+		default:
+			err = 1;
+			break;
+		}
+		if (err)
+			break;
+		if (action != MSW_AENDTURN)
+			last = rv; /* for the summary */
+		if (rv != expect) {
+			if (st->mismatches++ < 10)
+				fprintf(stderr, "game %ld, move %ld: expected \"%s\", "
+				        "got \"%s\"\n", st->games, moves,
+				        MSW_MSG[expect], MSW_MSG[rv]);
+		}
+		moves++;
+	}
+	if (q < end)
+		q++; /* the end marker */
+
+	if (st->verbose) {
+		msw_count(&game, &counts);
+		printf("game %ld: %dx%d, %d mines, seed %llu, %ld moves: %s "
+		       "(%ld uncovered, %ld flagged, %ld unknown)\n",
+		       st->games, game.rows, game.columns, game.mines,
+		       (unsigned long long)seed, moves,
+		       msw_won(&game) ? "won" : MSW_MSG[last], counts.revealed,
+		       counts.flagged, counts.unknown);
+		msw_print(&game, stdout);
+	}
+	if (st->engine)
+		msw_stats_add(st->engine, game.stats);
+	msw_destroy(&game);
+
+	st->games++;
+	st->moves += moves;
+	*p = q;
+	return err ? -1 : 0;
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-v] [-n REPEAT] [--stats] FILE...\n", name);
+	printf("\tReplay recorded games, checking every move's result.\n");
+	printf("\t-v: print each game's final board\n");
+	printf("\t-n: replay everything REPEAT times (for benchmarking)\n");
+	printf("\t--stats: print engine counters and latencies of all games\n");
+}
+
+/**
+ * @brief Replay game logs from the command line.
+ */
+int replay_main(int argc, char **argv)
+{
+	struct replay_stats st = { 0 };
+	struct msw_stats engine = { 0 };
+	const unsigned char *p, *end;
+	unsigned char *buf;
+	long size, repeat = 1;
+	uint64_t start;
+	double elapsed = 0;
+	FILE *f;
+	int i, r, verbose = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			repeat = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--stats") == 0) {
+			st.engine = &engine;
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (i == argc || repeat <= 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (; i < argc; i++) {
+		f = fopen(argv[i], "rb");
+		if (f == NULL) {
+			perror(argv[i]);
+			return EXIT_FAILURE;
+		}
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		rewind(f);
+		buf = malloc(size ? size : 1);
+		if (buf == NULL) {
+			fprintf(stderr, "error: malloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (fread(buf, 1, size, f) != (size_t)size) {
+			perror(argv[i]);
+			return EXIT_FAILURE;
+		}
+		fclose(f);
+
+		start = msw_stats_clock();
+		for (r = 0; r < repeat; r++) {
+			p = buf;
+			end = buf + size;
+			st.verbose = verbose && r == 0;
+			while (p < end) {
+				if (replay_game(&p, end, &st) < 0) {
+					fprintf(stderr, "%s: malformed log at "
+					        "byte %ld\n", argv[i],
+					        (long)(p - buf));
+					free(buf);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+		elapsed += (msw_stats_clock() - start) / 1e9;
+		free(buf);
+	}
+
+	printf("%ld games, %ld moves, %ld mismatches in %.3fs (%.0f moves/s)\n",
+	       st.games, st.moves, st.mismatches, elapsed,
+	       elapsed > 0 ? st.moves / elapsed : 0.0);
+	if (st.engine)
+		msw_stats_print(st.engine, stdout);
+	return st.mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,311 @@
+/***************************************************************************//**
+
+  @file         scan.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Whole-board scans, 16 or 32 cells at a time.
+
+  Checking for a win, counting the cells in each visible state and comparing
+  two boards all look at every cell, and each cell is one byte (see
+  MSW_CELL()), so they map directly onto SIMD compares: splitting a vector of
+  cells into its visible and grid halves takes a shift and two masks.  The
+  widest kernels the processor supports are picked the first time a scan
+  runs: AVX2, then SSE2, with plain C for the cells left over and for other
+  processors.
+
+*******************************************************************************/
+
+#include "minesweeper.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MSW_SCAN_X86
+#include <immintrin.h>
+#endif
+
+static int msw_scan_level = -1;
+
+/**
+ * @brief Choose the kernels used by whole-board scans.
+ * @param level The widest to use (an enum msw_simd), or -1 for the widest the
+ * processor supports.
+ * @returns The level in use, which is never wider than the processor supports.
+ *
+ * Scans choose for themselves, so this is only needed to compare the kernels.
+ */
+int msw_simd_select(int level)
+{
+	int best = MSW_SIMD_SCALAR;
+
+#ifdef MSW_SCAN_X86
+	if (__builtin_cpu_supports("avx2"))
+		best = MSW_SIMD_AVX2;
+	else if (__builtin_cpu_supports("sse2"))
+		best = MSW_SIMD_SSE2;
+#endif
+	if (level < 0 || level > best)
+		level = best;
+	__atomic_store_n(&msw_scan_level, level, __ATOMIC_RELAXED);
+	return level;
+}
+
+static inline int msw_scan_pick(void)
+{
+	int level = __atomic_load_n(&msw_scan_level, __ATOMIC_RELAXED);
+	return level >= 0 ? level : msw_simd_select(-1);
+}
+
+/*
+ * The scalar kernels, which also finish the cells after the last full vector.
+ * A game is won when every number is uncovered, and no mine: a mine's visible
+ * half only matches its grid half once it has exploded.
+ */
+static int msw_won_scalar(const unsigned char *cells, long i, long n)
+{
+	for (; i < n; i++)
+		if ((MSW_CELL_VIS(cells[i]) == MSW_CELL_GRID(cells[i])) ==
+		    (MSW_CELL_GRID(cells[i]) == MSW_CMINE))
+			return 0;
+	return 1;
+}
+
+static void msw_count_scalar(const unsigned char *cells, long i, long n,
+                             struct msw_counts *counts)
+{
+	long seen[16] = { 0 };
+
+	for (; i < n; i++)
+		seen[MSW_CELL_VIS(cells[i])]++;
+	for (i = MSW_CCLEAR; i < MSW_CMINE; i++)
+		counts->revealed += seen[i];
+	counts->flagged += seen[MSW_CFLAG];
+	counts->unknown += seen[MSW_CUNKNOWN];
+}
+
+static long msw_diff_scalar(const unsigned char *a, const unsigned char *b,
+                            long i, long n, int *cells, long max, long found)
+{
+	for (; i < n; i++) {
+		if (MSW_CELL_VIS(a[i]) == MSW_CELL_VIS(b[i]))
+			continue;
+		if (found < max)
+			cells[found] = i;
+		found++;
+	}
+	return found;
+}
+
+/*
+ * Record the cells from i whose bits are set in a mask of differences.
+ */
+static inline long msw_diff_mask(unsigned int mask, long i, int *cells,
+                                 long max, long found)
+{
+	for (; mask; mask &= mask - 1) {
+		if (found < max)
+			cells[found] = i + __builtin_ctz(mask);
+		found++;
+	}
+	return found;
+}
+
+#ifdef MSW_SCAN_X86
+
+__attribute__((target("sse2")))
+static int msw_won_sse2(const unsigned char *cells, long n)
+{
+	const __m128i low = _mm_set1_epi8(0xF), mine = _mm_set1_epi8(MSW_CMINE);
+	__m128i c, vis, grid, ok;
+	long i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		c = _mm_loadu_si128((const __m128i *)(cells + i));
+		vis = _mm_and_si128(_mm_srli_epi16(c, 4), low);
+		grid = _mm_and_si128(c, low);
+		ok = _mm_xor_si128(_mm_cmpeq_epi8(vis, grid),
+		                   _mm_cmpeq_epi8(grid, mine));
+		if (_mm_movemask_epi8(ok) != 0xFFFF)
+			return 0;
+	}
+	return msw_won_scalar(cells, i, n);
+}
+
+__attribute__((target("sse2")))
+static void msw_count_sse2(const unsigned char *cells, long n,
+                           struct msw_counts *counts)
+{
+	const __m128i low = _mm_set1_epi8(0xF), mine = _mm_set1_epi8(MSW_CMINE);
+	const __m128i flag = _mm_set1_epi8(MSW_CFLAG);
+	const __m128i unknown = _mm_set1_epi8(MSW_CUNKNOWN);
+	__m128i vis;
+	long i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		vis = _mm_loadu_si128((const __m128i *)(cells + i));
+		vis = _mm_and_si128(_mm_srli_epi16(vis, 4), low);
+		counts->revealed += __builtin_popcount(
+			_mm_movemask_epi8(_mm_cmplt_epi8(vis, mine)));
+		counts->flagged += __builtin_popcount(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(vis, flag)));
+		counts->unknown += __builtin_popcount(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(vis, unknown)));
+	}
+	msw_count_scalar(cells, i, n, counts);
+}
+
+__attribute__((target("sse2")))
+static long msw_diff_sse2(const unsigned char *a, const unsigned char *b,
+                          long n, int *cells, long max)
+{
+	const __m128i high = _mm_set1_epi8((char)0xF0);
+	__m128i x;
+	long i, found = 0;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+		                  _mm_loadu_si128((const __m128i *)(b + i)));
+		x = _mm_cmpeq_epi8(_mm_and_si128(x, high), _mm_setzero_si128());
+		found = msw_diff_mask(~_mm_movemask_epi8(x) & 0xFFFF, i, cells,
+		                      max, found);
+	}
+	return msw_diff_scalar(a, b, i, n, cells, max, found);
+}
+
+__attribute__((target("avx2")))
+static int msw_won_avx2(const unsigned char *cells, long n)
+{
+	const __m256i low = _mm256_set1_epi8(0xF);
+	const __m256i mine = _mm256_set1_epi8(MSW_CMINE);
+	__m256i c, vis, grid, ok;
+	long i;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		c = _mm256_loadu_si256((const __m256i *)(cells + i));
+		vis = _mm256_and_si256(_mm256_srli_epi16(c, 4), low);
+		grid = _mm256_and_si256(c, low);
+		ok = _mm256_xor_si256(_mm256_cmpeq_epi8(vis, grid),
+		                      _mm256_cmpeq_epi8(grid, mine));
+		if (_mm256_movemask_epi8(ok) != -1)
+			return 0;
+	}
+	return msw_won_scalar(cells, i, n);
+}
+
+__attribute__((target("avx2,popcnt")))
+static void msw_count_avx2(const unsigned char *cells, long n,
+                           struct msw_counts *counts)
+{
+	const __m256i low = _mm256_set1_epi8(0xF);
+	const __m256i mine = _mm256_set1_epi8(MSW_CMINE);
+	const __m256i flag = _mm256_set1_epi8(MSW_CFLAG);
+	const __m256i unknown = _mm256_set1_epi8(MSW_CUNKNOWN);
+	__m256i vis;
+	long i;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		vis = _mm256_loadu_si256((const __m256i *)(cells + i));
+		vis = _mm256_and_si256(_mm256_srli_epi16(vis, 4), low);
+		counts->revealed += __builtin_popcount(
+			_mm256_movemask_epi8(_mm256_cmpgt_epi8(mine, vis)));
+		counts->flagged += __builtin_popcount(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(vis, flag)));
+		counts->unknown += __builtin_popcount(
+			_mm256_movemask_epi8(_mm256_cmpeq_epi8(vis, unknown)));
+	}
+	msw_count_scalar(cells, i, n, counts);
+}
+
+__attribute__((target("avx2")))
+static long msw_diff_avx2(const unsigned char *a, const unsigned char *b,
+                          long n, int *cells, long max)
+{
+	const __m256i high = _mm256_set1_epi8((char)0xF0);
+	__m256i x;
+	long i, found = 0;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+		x = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *)(a + i)),
+			_mm256_loadu_si256((const __m256i *)(b + i)));
+		x = _mm256_cmpeq_epi8(_mm256_and_si256(x, high),
+		                      _mm256_setzero_si256());
+		found = msw_diff_mask(~_mm256_movemask_epi8(x), i, cells, max,
+		                      found);
+	}
+	return msw_diff_scalar(a, b, i, n, cells, max, found);
+}
+
+#endif /* MSW_SCAN_X86 */
+
+/**
+ * @brief Return whether a game is won: every number uncovered, and no mine.
+ */
+int msw_scan_won(msw *game)
+{
+	long n = (long)game->rows * game->columns;
+
+	switch (msw_scan_pick()) {
+#ifdef MSW_SCAN_X86
+	case MSW_SIMD_AVX2:
+		return msw_won_avx2(game->cells, n);
+	case MSW_SIMD_SSE2:
+		return msw_won_sse2(game->cells, n);
+#endif
+	default:
+		return msw_won_scalar(game->cells, 0, n);
+	}
+}
+
+/**
+ * @brief Count a game's cells in each visible state.
+ * @param game The game.
+ * @param counts Receives the counts. Cells in none of them are exploded mines.
+ */
+void msw_count(msw *game, struct msw_counts *counts)
+{
+	long n = (long)game->rows * game->columns;
+
+	counts->revealed = counts->flagged = counts->unknown = 0;
+	switch (msw_scan_pick()) {
+#ifdef MSW_SCAN_X86
+	case MSW_SIMD_AVX2:
+		msw_count_avx2(game->cells, n, counts);
+		break;
+	case MSW_SIMD_SSE2:
+		msw_count_sse2(game->cells, n, counts);
+		break;
+#endif
+	default:
+		msw_count_scalar(game->cells, 0, n, counts);
+		break;
+	}
+}
+
+/**
+ * @brief Compare the visible boards of two games of the same size.
+ * @param a One game.
+ * @param b The other.
+ * @param cells Receives the row-major indices of the first max cells which
+ * differ, in order (may be NULL if max is 0).
+ * @param max Size of cells.
+ * @returns The number of cells which differ, or -1 if the sizes differ.
+ */
+long msw_diff(msw *a, msw *b, int *cells, long max)
+{
+	long n = (long)a->rows * a->columns;
+
+	if (a->rows != b->rows || a->columns != b->columns)
+		return -1;
+	switch (msw_scan_pick()) {
+#ifdef MSW_SCAN_X86
+	case MSW_SIMD_AVX2:
+		return msw_diff_avx2(a->cells, b->cells, n, cells, max);
+	case MSW_SIMD_SSE2:
+		return msw_diff_sse2(a->cells, b->cells, n, cells, max);
+#endif
+	default:
+		return msw_diff_scalar(a->cells, b->cells, 0, n, cells, max, 0);
+	}
+}
@@ -0,0 +1,364 @@
+/***************************************************************************//**
+
+  @file         serialize.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Compact binary serialization of a game.
+
+  The format is little endian and versioned:
+
+      "MSWG" version:u8 parts:u8
+      rows:varint columns:varint mines:varint flags:varint seed:u64
+      [mine bitmap, 1 bit per cell]               if parts & MSW_SER_GRID
+      visible states, 2 bits per cell
+      [cap gen idx count:varint, entries]         if parts & MSW_SER_UNDO
+
+  Cell numbers are not stored; they are recomputed from the mine bitmap.
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "encode.h"
+#include "minesweeper.h"
+
+#define MSW_SER_MAGIC "MSWG"
+#define MSW_SER_VERSION 1
+
+#define MSW_SER_GRID 0x01
+#define MSW_SER_UNDO 0x02
+
+/* 2-bit visible cell states */
+#define MSW_SV_UNKNOWN 0
+#define MSW_SV_FLAG 1
+#define MSW_SV_REVEALED 2
+#define MSW_SV_BOOM 3
+
+/* 4-bit codes for the old/new values of undo entries */
+#define MSW_SU_MINE 9
+#define MSW_SU_UNKNOWN 10
+#define MSW_SU_FLAG 11
+
+struct msw_writer {
+	unsigned char *buf;
+	size_t len, pos;
+};
+
+struct msw_reader {
+	const unsigned char *buf;
+	size_t len, pos;
+	int err;
+};
+
+static void put_byte(struct msw_writer *w, unsigned char b)
+{
+	if (w->pos < w->len)
+		w->buf[w->pos] = b;
+	w->pos++;
+}
+
+static void put_bytes(struct msw_writer *w, const unsigned char *b, int n)
+{
+	for (int i = 0; i < n; i++)
+		put_byte(w, b[i]);
+}
+
+static void put_varint(struct msw_writer *w, uint64_t v)
+{
+	unsigned char b[MSW_VARINT_MAX];
+	put_bytes(w, b, msw_put_varint(b, v));
+}
+
+static void put_u64(struct msw_writer *w, uint64_t v)
+{
+	unsigned char b[8];
+	msw_put_le64(b, v);
+	put_bytes(w, b, 8);
+}
+
+static unsigned char get_byte(struct msw_reader *r)
+{
+	if (r->pos >= r->len) {
+		r->err = 1;
+		return 0;
+	}
+	return r->buf[r->pos++];
+}
+
+static uint64_t get_varint(struct msw_reader *r)
+{
+	const unsigned char *p = r->buf + r->pos;
+	uint64_t v = msw_get_varint(&p, r->buf + r->len, &r->err);
+	r->pos = p - r->buf;
+	return v;
+}
+
+static uint64_t get_u64(struct msw_reader *r)
+{
+	uint64_t v;
+	if (r->pos + 8 > r->len) {
+		r->err = 1;
+		return 0;
+	}
+	v = msw_get_le64(r->buf + r->pos);
+	r->pos += 8;
+	return v;
+}
+
+static int ser_visible_state(char vis)
+{
+	switch (vis) {
+	case MSW_UNKNOWN:
+		return MSW_SV_UNKNOWN;
+	case MSW_FLAG:
+		return MSW_SV_FLAG;
+	case MSW_MINE:
+		return MSW_SV_BOOM;
+	default:
+		return MSW_SV_REVEALED;
+	}
+}
+
+static int ser_undo_code(char vis)
+{
+	switch (vis) {
+	case MSW_UNKNOWN:
+		return MSW_SU_UNKNOWN;
+	case MSW_FLAG:
+		return MSW_SU_FLAG;
+	case MSW_MINE:
+		return MSW_SU_MINE;
+	default:
+		return vis - '0';
+	}
+}
+
+static char deser_undo_code(int code)
+{
+	switch (code) {
+	case MSW_SU_UNKNOWN:
+		return MSW_UNKNOWN;
+	case MSW_SU_FLAG:
+		return MSW_FLAG;
+	case MSW_SU_MINE:
+		return MSW_MINE;
+	default:
+		return '0' + code;
+	}
+}
+
+/*
+ * Return the number of live undo entries, ending just before undoend. Walking
+ * backwards, generations never increase; the sentinel (generation 0) or an
+ * older, overwritten entry marks the beginning.
+ */
+static int ser_undo_count(msw *game)
+{
+	int count = 0;
+	int idx = game->undoend;
+	int gen = game->undo[(idx + game->undocap - 1) % game->undocap].gen;
+
+	while (count < game->undocap - 1) {
+		idx = (idx + game->undocap - 1) % game->undocap;
+		if (game->undo[idx].gen == 0 || game->undo[idx].gen > gen)
+			break;
+		gen = game->undo[idx].gen;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * @brief Serialize a game into a buffer.
+ * @param game The game to serialize.
+ * @param buf Buffer to write into (may be NULL if len is 0).
+ * @param len Size of the buffer.
+ * @returns The size of the serialized game. If this is larger than len, the
+ * buffer contents are incomplete and the call should be repeated with a buffer
+ * of at least this size.
+ */
+size_t msw_serialize(msw *game, unsigned char *buf, size_t len)
+{
+	struct msw_writer w = { .buf = buf, .len = len, .pos = 0 };
+	unsigned char acc;
+	int i, n, vis, count, start, prevgen;
+	int ncells = game->rows * game->columns;
+	struct msw_undo_entry *e;
+
+	for (i = 0; i < 4; i++)
+		put_byte(&w, MSW_SER_MAGIC[i]);
+	put_byte(&w, MSW_SER_VERSION);
+	put_byte(&w, (game->has_grid ? MSW_SER_GRID : 0) |
+	             (game->undo ? MSW_SER_UNDO : 0));
+	put_varint(&w, game->rows);
+	put_varint(&w, game->columns);
+	put_varint(&w, game->mines);
+	put_varint(&w, game->flags);
+	put_u64(&w, game->seed);
+
+	if (game->has_grid) {
+		acc = n = 0;
+		for (i = 0; i < ncells; i++) {
+			if (MSW_CELL_GRID(game->cells[i]) == MSW_CMINE)
+				acc |= 1 << n;
+			if (++n == 8) {
+				put_byte(&w, acc);
+				acc = n = 0;
+			}
+		}
+		if (n)
+			put_byte(&w, acc);
+	}
+
+	acc = n = 0;
+	for (i = 0; i < ncells; i++) {
+		vis = MSW_CELL_VIS(game->cells[i]);
+		acc |= ser_visible_state(msw_chars[vis]) << (2 * n);
+		if (++n == 4) {
+			put_byte(&w, acc);
+			acc = n = 0;
+		}
+	}
+	if (n)
+		put_byte(&w, acc);
+
+	if (game->undo) {
+		count = ser_undo_count(game);
+		start = (game->undoend - count + game->undocap) % game->undocap;
+		put_varint(&w, game->undocap);
+		put_varint(&w, game->gen);
+		put_varint(&w, (game->undoidx - start + game->undocap) %
+		                       game->undocap);
+		put_varint(&w, count);
+		prevgen = 0;
+		for (i = 0; i < count; i++) {
+			e = &game->undo[(start + i) % game->undocap];
+			put_varint(&w, e->loc.row * game->columns + e->loc.col);
+			put_varint(&w, e->gen - prevgen);
+			put_byte(&w, ser_undo_code(e->old) |
+			             ser_undo_code(e->new) << 4);
+			prevgen = e->gen;
+		}
+	}
+
+	return w.pos;
+}
+
+/**
+ * @brief Initialize a game from a buffer produced by msw_serialize().
+ * @param game Uninitialized game to load into.
+ * @param buf Serialized game.
+ * @param len Size of the serialized game.
+ * @returns 0 on success, -1 if the buffer is malformed (game is then left
+ * uninitialized).
+ */
+int msw_deserialize(msw *game, const unsigned char *buf, size_t len)
+{
+	struct msw_reader r = { .buf = buf, .len = len, .pos = 0, .err = 0 };
+	unsigned char acc = 0, parts;
+	uint64_t rows, columns, mines, flags, cap, gen, idx, count, cell;
+	size_t need;
+	int i, n, ncells, state, vis, gendelta, prevgen;
+	struct msw_undo_entry *e;
+
+	if (len < 6 || memcmp(buf, MSW_SER_MAGIC, 4) != 0 ||
+	    buf[4] != MSW_SER_VERSION)
+		return -1;
+	r.pos = 5;
+	parts = get_byte(&r);
+	rows = get_varint(&r);
+	columns = get_varint(&r);
+	mines = get_varint(&r);
+	flags = get_varint(&r);
+	if (r.err || rows == 0 || columns == 0 || rows > 0xFFFF ||
+	    columns > 0xFFFF || rows * columns > 0x7FFFFFFF ||
+	    mines >= rows * columns || flags > rows * columns)
+		return -1;
+	ncells = rows * columns;
+
+	// Make sure the buffer holds the seed and every cell before allocating.
+	need = 8 + ((size_t)ncells + 3) / 4;
+	if (parts & MSW_SER_GRID)
+		need += ((size_t)ncells + 7) / 8;
+	if (r.len - r.pos < need)
+		return -1;
+
+	msw_init(game, rows, columns, mines);
+	game->seed = get_u64(&r);
+	game->flags = flags;
+
+	if (parts & MSW_SER_GRID) {
+		n = 8;
+		for (i = 0; i < ncells; i++) {
+			if (n == 8) {
+				acc = get_byte(&r);
+				n = 0;
+			}
+			if ((acc >> n++) & 1)
+				game->cells[i] |= MSW_CMINE;
+		}
+		game->has_grid = 1;
+		msw_number_grid(game);
+	}
+
+	n = 4;
+	for (i = 0; i < ncells; i++) {
+		if (n == 4) {
+			acc = get_byte(&r);
+			n = 0;
+		}
+		state = (acc >> (2 * n++)) & 3;
+		vis = MSW_CUNKNOWN;
+		if (state == MSW_SV_FLAG)
+			vis = MSW_CFLAG;
+		else if (state == MSW_SV_BOOM)
+			vis = MSW_CMINE;
+		else if (state == MSW_SV_REVEALED && game->has_grid)
+			vis = MSW_CELL_GRID(game->cells[i]);
+		else if (state == MSW_SV_REVEALED)
+			r.err = 1;
+		game->cells[i] = MSW_CELL(vis, MSW_CELL_GRID(game->cells[i]));
+		game->hash ^= msw_hash_cell(i, msw_chars[vis]);
+	}
+
+	if (parts & MSW_SER_UNDO) {
+		cap = get_varint(&r);
+		gen = get_varint(&r);
+		idx = get_varint(&r);
+		count = get_varint(&r);
+		// Each entry takes at least three bytes.
+		if (r.err || cap < 2 || cap > MSW_UNDO_MAX || count > cap - 1 ||
+		    count > (r.len - r.pos) / 3 || idx > count || gen > 1 << 30)
+			goto fail;
+		msw_enable_undo_logging(game, cap);
+		game->gen = gen;
+		prevgen = 0;
+		for (i = 0; i < (int)count; i++) {
+			e = &game->undo[1 + i];
+			cell = get_varint(&r);
+			gendelta = get_varint(&r);
+			acc = get_byte(&r);
+			if (cell >= (uint64_t)ncells || gendelta < 0)
+				goto fail;
+			e->loc.row = cell / columns;
+			e->loc.col = cell % columns;
+			e->gen = prevgen + gendelta;
+			e->old = deser_undo_code(acc & 0xF);
+			e->new = deser_undo_code(acc >> 4);
+			prevgen = e->gen;
+		}
+		game->undoidx = (1 + idx) % cap;
+		game->undoend = (1 + count) % cap;
+	}
+
+	if (r.err)
+		goto fail;
+	return 0;
+fail:
+	msw_destroy(game);
+	return -1;
+}
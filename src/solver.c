@@ -0,0 +1,1089 @@
+/***************************************************************************//**
+
+  @file         solver.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Anytime solver: the best move it can find within a budget.
+
+  The solver tries increasingly expensive stages until one produces a move:
+
+  1. and 2. msw_ai_deduce(): moves which follow from one number, or from one
+     number's unknown neighbors containing another's.
+  3. CSP: the unknown cells next to numbers (the frontier) are split into
+     independent components, and every layout of mines in a component which
+     satisfies its numbers is enumerated.  A cell which is safe (or a mine) in
+     every layout is certain.
+  4. Sample: each unknown cell's chance of being a mine is worked out, exactly
+     for components the CSP finished (weighing every way the mines left can be
+     split between them and the rest of the board) and heuristically for the
+     rest.  When several cells are equally safe, whole boards are sampled from
+     the layouts the CSP found to see which of them most often opens up.
+  5. Guess: without samples, simply dig the safest cell.
+
+  The CSP and sampling stages are open-ended.  When the budget runs out they
+  stop, and the later stages work with what they have, so there is always an
+  answer.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minesweeper.h"
+
+/* Nodes between checks of the clock and the cancel flag. */
+#define MSW_SOLVER_CHECK 1024
+
+/* Layouts of each component kept for sampling. */
+#define MSW_SOLVER_RESERVOIR 64
+
+/*
+ * Largest component whose layouts are also counted per cell and number of
+ * mines, which is what exact probabilities need.
+ */
+#define MSW_SOLVER_EXACT 128
+
+/* Most work (frontier cells times mines left) for combining components. */
+#define MSW_SOLVER_COMBINE (1 << 24)
+
+/* Guesses considered by the sampling stage: frontier cells, and cells off it. */
+#define MSW_SOLVER_FRONTIER_CANDIDATES 12
+#define MSW_SOLVER_OTHER_CANDIDATES 4
+#define MSW_SOLVER_CANDIDATES \
+	(MSW_SOLVER_FRONTIER_CANDIDATES + MSW_SOLVER_OTHER_CANDIDATES)
+
+/*
+ * How much more likely to be a mine than the safest cell a candidate may be:
+ * only rounding. Trading any real risk for information lost more games than it
+ * won when measured.
+ */
+#define MSW_SOLVER_MARGIN 1e-9
+
+/* A revealed number: the frontier cells around it hold need mines. */
+struct msw_cons {
+	int need;  /* mines still to place among unassigned cells */
+	int left;  /* unassigned cells */
+	int nvars;
+	int vars[NUM_NEIGHBORS];
+};
+
+/*
+ * A uniform random sample of a component's layouts, kept while enumerating
+ * them. Once the weight of each number of mines is known, samples are drawn
+ * from it in proportion.
+ */
+struct msw_reservoir {
+	int n;
+	double seen;   /* layouts offered */
+	int *mines;    /* in each layout kept */
+	double *cum;   /* cumulative weight of the layouts kept */
+	char *layouts; /* MSW_SOLVER_RESERVOIR rows of the component's size */
+};
+
+struct msw_solver {
+	msw *game;
+	const struct msw_ai_budget *budget;
+	uint64_t deadline; /* msw_stats_clock() reading, 0 for none */
+	long nodes;
+	int stopped;
+
+	/* Frontier cells (variables), and the numbers constraining them. */
+	int nvars, ncons;
+	int *cell;      /* cell index of each variable */
+	int *varof;     /* variable of each cell, or -1 */
+	int *varcons;   /* NUM_NEIGHBORS constraints per variable */
+	int *nvarcons;
+	struct msw_cons *cons;
+
+	/* Components, as runs of variables in search order. */
+	int ncomps;
+	int *order;
+	int *compstart, *compsize;
+	char *complete; /* per component */
+
+	/* Layouts found: in all and with each variable a mine, then per
+	   component by number of mines k, and (for small components) with the
+	   variable at position i a mine and k mines, at [i * (size + 1) + k]. */
+	double *mines;
+	double layouts;
+	double **count, **minesk;
+	double **weight; /* relative chance of a component holding k mines */
+	int remaining; /* mines not flagged */
+	int unknown;   /* unknown cells */
+
+	/* Chance of a mine in each cell, for the guessing stages. */
+	double *prob;
+	double density; /* of the unknown cells off the frontier */
+
+	/* For sampling: layouts of complete components, and where to find a
+	   variable in them. */
+	struct msw_reservoir *res;
+	int *varcomp, *varpos;
+	uint64_t rng;
+};
+
+/* One thread's share of the sampling stage. */
+struct msw_sampler {
+	struct msw_solver *s;
+	pthread_t thread;
+	uint64_t rng;
+	long samples;
+	int ncand;
+	const int *cand;
+	int sample;             /* number of the current sample, from 1 */
+	int *cellstamp, *compstamp;
+	char *cellmine;
+	int *choice;            /* reservoir layout of each component */
+	double safe[MSW_SOLVER_CANDIDATES];
+	double opens[MSW_SOLVER_CANDIDATES];
+};
+
+/*
+ * Splitmix64, one state per thread.
+ */
+static uint64_t msw_solver_rand(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/* Uniform in (0, 1]. */
+static double msw_solver_uniform(uint64_t *state)
+{
+	return ((msw_solver_rand(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static int msw_solver_timeout(struct msw_solver *s)
+{
+	if (s->budget->cancel &&
+	    __atomic_load_n(s->budget->cancel, __ATOMIC_RELAXED))
+		return 1;
+	return s->deadline && msw_stats_clock() >= s->deadline;
+}
+
+/*
+ * Count a node of the search, returning nonzero if the budget has run out.
+ */
+static int msw_solver_tick(struct msw_solver *s)
+{
+	s->nodes++;
+	if (s->budget->nodes > 0 && s->nodes > s->budget->nodes)
+		s->stopped = 1;
+	else if (s->nodes % MSW_SOLVER_CHECK == 0 && msw_solver_timeout(s))
+		s->stopped = 1;
+	return s->stopped;
+}
+
+/*
+ * Find the frontier and the numbers around it.
+ */
+static void msw_solver_build(struct msw_solver *s)
+{
+	msw *game = s->game;
+	int ncells = game->rows * game->columns;
+	struct msw_loc loc, neigh;
+	struct msw_cons *c;
+	int iter, idx, v;
+	char val, nval;
+
+	s->varof = msw_calloc(ncells, sizeof(int));
+	s->cell = msw_calloc(ncells, sizeof(int));
+	s->cons = msw_calloc(ncells, sizeof(struct msw_cons));
+	for (idx = 0; idx < ncells; idx++)
+		s->varof[idx] = -1;
+
+	for_each_row_col(game, loc)
+	{
+		val = msw_get_visible(game, loc);
+		if (val < '1' || val > '8')
+			continue;
+		c = &s->cons[s->ncons];
+		c->need = val - '0';
+		c->left = c->nvars = 0;
+		for_each_neigh(game, neigh, &loc, iter)
+		{
+			nval = msw_get_visible(game, neigh);
+			if (nval == MSW_FLAG || nval == MSW_MINE) {
+				c->need--;
+			} else if (nval == MSW_UNKNOWN) {
+				idx = msw_index(game, neigh.row, neigh.col);
+				if (s->varof[idx] < 0) {
+					s->varof[idx] = s->nvars;
+					s->cell[s->nvars++] = idx;
+				}
+				c->vars[c->nvars++] = s->varof[idx];
+				c->left++;
+			}
+		}
+		if (c->nvars)
+			s->ncons++;
+	}
+
+	s->varcons = msw_calloc(s->nvars, NUM_NEIGHBORS * sizeof(int));
+	s->nvarcons = msw_calloc(s->nvars, sizeof(int));
+	for (idx = 0; idx < s->ncons; idx++) {
+		for (iter = 0; iter < s->cons[idx].nvars; iter++) {
+			v = s->cons[idx].vars[iter];
+			s->varcons[v * NUM_NEIGHBORS + s->nvarcons[v]++] = idx;
+		}
+	}
+}
+
+/*
+ * Split the frontier into components which share no numbers, each ordered
+ * breadth first so that neighboring cells are decided together.
+ */
+static void msw_solver_components(struct msw_solver *s)
+{
+	char *seen = msw_calloc(s->nvars, 1);
+	int head, tail = 0, v, w, i, j;
+	struct msw_cons *c;
+
+	s->order = msw_calloc(s->nvars, sizeof(int));
+	s->compstart = msw_calloc(s->nvars, sizeof(int));
+	s->compsize = msw_calloc(s->nvars, sizeof(int));
+	s->varcomp = msw_calloc(s->nvars, sizeof(int));
+	s->varpos = msw_calloc(s->nvars, sizeof(int));
+	for (v = 0; v < s->nvars; v++) {
+		if (seen[v])
+			continue;
+		s->compstart[s->ncomps] = head = tail;
+		s->order[tail++] = v;
+		seen[v] = 1;
+		for (; head < tail; head++) {
+			w = s->order[head];
+			for (i = 0; i < s->nvarcons[w]; i++) {
+				c = &s->cons[s->varcons[w * NUM_NEIGHBORS + i]];
+				for (j = 0; j < c->nvars; j++) {
+					if (!seen[c->vars[j]]) {
+						seen[c->vars[j]] = 1;
+						s->order[tail++] = c->vars[j];
+					}
+				}
+			}
+		}
+		s->compsize[s->ncomps] = tail - s->compstart[s->ncomps];
+		for (i = s->compstart[s->ncomps]; i < tail; i++) {
+			s->varcomp[s->order[i]] = s->ncomps;
+			s->varpos[s->order[i]] = i - s->compstart[s->ncomps];
+		}
+		s->ncomps++;
+	}
+	s->complete = msw_calloc(s->ncomps, 1);
+	s->count = msw_calloc(s->ncomps, sizeof(double *));
+	s->minesk = msw_calloc(s->ncomps, sizeof(double *));
+	s->weight = msw_calloc(s->ncomps, sizeof(double *));
+	s->res = msw_calloc(s->ncomps, sizeof(struct msw_reservoir));
+	free(seen);
+}
+
+/*
+ * Assign a variable (1 for a mine), returning nonzero if every number it
+ * touches can still be satisfied. Assignments are always applied in full, so
+ * that msw_solver_unset() can undo them.
+ */
+static int msw_solver_set(struct msw_solver *s, int v, int mine)
+{
+	struct msw_cons *c;
+	int i, ok = 1;
+
+	for (i = 0; i < s->nvarcons[v]; i++) {
+		c = &s->cons[s->varcons[v * NUM_NEIGHBORS + i]];
+		c->left--;
+		c->need -= mine;
+		if (c->need < 0 || c->need > c->left)
+			ok = 0;
+	}
+	return ok;
+}
+
+static void msw_solver_unset(struct msw_solver *s, int v, int mine)
+{
+	struct msw_cons *c;
+	int i;
+
+	for (i = 0; i < s->nvarcons[v]; i++) {
+		c = &s->cons[s->varcons[v * NUM_NEIGHBORS + i]];
+		c->left++;
+		c->need += mine;
+	}
+}
+
+/*
+ * Offer a layout of a component, with k mines, to its reservoir.
+ */
+static void msw_solver_keep(struct msw_solver *s, int comp, const char *mine,
+                            int k)
+{
+	struct msw_reservoir *r = &s->res[comp];
+	int n = s->compsize[comp], slot;
+	double j;
+
+	if (r->layouts == NULL) {
+		r->mines = msw_calloc(MSW_SOLVER_RESERVOIR, sizeof(int));
+		r->cum = msw_calloc(MSW_SOLVER_RESERVOIR, sizeof(double));
+		r->layouts = msw_calloc(MSW_SOLVER_RESERVOIR, n);
+	}
+	r->seen += 1;
+	if (r->n < MSW_SOLVER_RESERVOIR) {
+		slot = r->n++;
+	} else {
+		j = floor(msw_solver_uniform(&s->rng) * r->seen);
+		if (j >= MSW_SOLVER_RESERVOIR)
+			return;
+		slot = j;
+	}
+	r->mines[slot] = k;
+	memcpy(r->layouts + (size_t)slot * n, mine, n);
+}
+
+/*
+ * Log of the binomial coefficient.
+ */
+static double msw_solver_lchoose(int n, int r)
+{
+	return lgamma(n + 1.0) - lgamma(r + 1.0) - lgamma(n - r + 1.0);
+}
+
+/*
+ * Enumerate every layout of a component, counting them by number of mines.
+ * Returns 0 if the budget ran out first.
+ */
+static int msw_solver_enumerate(struct msw_solver *s, int comp)
+{
+	const int *vars = s->order + s->compstart[comp];
+	int n = s->compsize[comp];
+	char *state = msw_calloc(n + 1, 1); /* 0 untried, 1 safe, 2 mine */
+	char *mine = msw_calloc(n, 1);
+	int depth = 0, k = 0, i;
+	int others = s->unknown - n;
+	double *count, *minesk = NULL;
+
+	count = s->count[comp] = msw_calloc(n + 1, sizeof(double));
+	if (n <= MSW_SOLVER_EXACT) {
+		minesk = msw_calloc((size_t)n * (n + 1), sizeof(double));
+		s->minesk[comp] = minesk;
+	}
+	s->layouts = 0;
+	while (depth >= 0) {
+		if (depth == n) {
+			// A complete layout, unless it leaves more mines than
+			// there are cells to put them in.
+			depth--;
+			if (s->remaining - k > others)
+				continue;
+			s->layouts += 1;
+			count[k] += 1;
+			for (i = 0; i < n; i++) {
+				if (!mine[i])
+					continue;
+				s->mines[vars[i]] += 1;
+				if (minesk)
+					minesk[i * (n + 1) + k] += 1;
+			}
+			if (minesk && s->budget->samples > 0)
+				msw_solver_keep(s, comp, mine, k);
+			continue;
+		}
+		if (msw_solver_tick(s))
+			break;
+		if (state[depth]) {
+			msw_solver_unset(s, vars[depth], mine[depth]);
+			k -= mine[depth];
+		}
+		if (state[depth] == 2) {
+			state[depth] = 0;
+			depth--;
+			continue;
+		}
+		mine[depth] = state[depth]++;
+		k += mine[depth];
+		if (msw_solver_set(s, vars[depth], mine[depth]) &&
+		    k <= s->remaining)
+			depth++;
+	}
+
+	// Leave the numbers as they were, if we stopped partway.
+	for (; depth >= 0; depth--) {
+		if (depth < n && state[depth])
+			msw_solver_unset(s, vars[depth], mine[depth]);
+	}
+	free(state);
+	free(mine);
+	return !s->stopped && s->layouts > 0;
+}
+
+/*
+ * Run the CSP stage, smallest components first. Returns a certain move, or
+ * AI_NONE.
+ */
+static struct msw_ai_move msw_solver_csp(struct msw_solver *s)
+{
+	struct msw_ai_move move = { .action = AI_NONE };
+	int *bysize, comp, i, j, v;
+
+	bysize = msw_calloc(s->ncomps, sizeof(int));
+	for (i = 0; i < s->ncomps; i++)
+		bysize[i] = i;
+	// Insertion sort: there are seldom many components.
+	for (i = 1; i < s->ncomps; i++) {
+		v = bysize[i];
+		for (j = i; j > 0 && s->compsize[bysize[j - 1]] > s->compsize[v];
+		     j--)
+			bysize[j] = bysize[j - 1];
+		bysize[j] = v;
+	}
+
+	for (i = 0; i < s->ncomps && move.action == AI_NONE; i++) {
+		comp = bysize[i];
+		msw_trace_begin("csp component", s->compsize[comp]);
+		if (!msw_solver_enumerate(s, comp)) {
+			msw_trace_end("csp component");
+			break;
+		}
+		msw_trace_end("csp component");
+		s->complete[comp] = 1;
+		for (j = 0; j < s->compsize[comp]; j++) {
+			v = s->order[s->compstart[comp] + j];
+			if (s->mines[v] == 0) {
+				move.action = AI_DIG;
+				move.description = "Dig (safe in every consistent layout)";
+			} else if (s->mines[v] == s->layouts &&
+			           move.action == AI_NONE) {
+				move.action = AI_FLAG;
+				move.description = "Flag (mine in every consistent layout)";
+			} else {
+				continue;
+			}
+			move.loc.row = s->cell[v] / s->game->columns;
+			move.loc.col = s->cell[v] % s->game->columns;
+			if (move.action == AI_DIG)
+				break;
+		}
+	}
+	free(bysize);
+	return move;
+}
+
+/*
+ * Convolve two distributions of mine counts, dropping counts above the mines
+ * left, and scale the result so that its largest entry is 1 (only the ratios
+ * matter). Returns the length of the result.
+ */
+static int msw_solver_convolve(const double *a, int na, const double *b, int nb,
+                               double *out, int remaining)
+{
+	int n = na + nb - 1 < remaining + 1 ? na + nb - 1 : remaining + 1;
+	double max = 0;
+	int i, j;
+
+	for (i = 0; i < n; i++)
+		out[i] = 0;
+	for (i = 0; i < na; i++)
+		for (j = 0; j < nb && i + j < n; j++)
+			out[i + j] += a[i] * b[j];
+	for (i = 0; i < n; i++)
+		if (out[i] > max)
+			max = out[i];
+	for (i = 0; max > 0 && i < n; i++)
+		out[i] /= max;
+	return n;
+}
+
+/*
+ * Weigh each number of mines in each of comps[lo..hi), given the distribution
+ * of mines in all the other components (outside). binom[j] is the relative
+ * number of ways to place the rest of the mines off these components, when
+ * they hold j. Halving the range each time means every component is only
+ * convolved into a logarithmic number of distributions.
+ */
+static void msw_solver_split(struct msw_solver *s, const int *comps, int lo,
+                             int hi, const double *outside, int nout,
+                             const double *binom)
+{
+	double *in, *out, *tmp;
+	int comp, n, i, j, k, mid;
+
+	if (hi - lo == 1) {
+		comp = comps[lo];
+		n = s->compsize[comp];
+		s->weight[comp] = msw_calloc(n + 1, sizeof(double));
+		for (k = 0; k <= n && k <= s->remaining; k++)
+			for (j = 0; j < nout && j + k <= s->remaining; j++)
+				s->weight[comp][k] += outside[j] * binom[j + k];
+		return;
+	}
+
+	mid = lo + (hi - lo) / 2;
+	in = msw_calloc(s->remaining + 1, sizeof(double));
+	out = msw_calloc(s->remaining + 1, sizeof(double));
+	for (i = 0; i < 2; i++) {
+		// Each half sees the outside and the other half.
+		memcpy(in, outside, nout * sizeof(double));
+		n = nout;
+		for (j = i ? lo : mid; j < (i ? mid : hi); j++) {
+			comp = comps[j];
+			n = msw_solver_convolve(in, n, s->count[comp],
+			                        s->compsize[comp] + 1, out,
+			                        s->remaining);
+			tmp = in;
+			in = out;
+			out = tmp;
+		}
+		if (i)
+			msw_solver_split(s, comps, mid, hi, in, n, binom);
+		else
+			msw_solver_split(s, comps, lo, mid, in, n, binom);
+	}
+	free(in);
+	free(out);
+}
+
+/*
+ * Weigh each number of mines in each component whose layouts were all counted,
+ * taking every other such component into account: a combination of layouts
+ * holding j mines in all leaves C(cells, mines - j) ways to place the rest
+ * among the other unknown cells. Returns the expected number of mines among
+ * those other cells, or -1 if the work would be too much (or the board is
+ * inconsistent).
+ */
+static double msw_solver_combine(struct msw_solver *s, const int *comps,
+                                 int ncomps)
+{
+	int pool = s->unknown, frontier = 0, n = 1, i, j;
+	double *binom, *all, *tmp, total = 0, expected = 0, max = -HUGE_VAL;
+
+	for (i = 0; i < ncomps; i++)
+		frontier += s->compsize[comps[i]];
+	pool -= frontier;
+	if (s->remaining < 0 ||
+	    (double)frontier * (s->remaining + 1) > MSW_SOLVER_COMBINE)
+		return -1;
+
+	binom = msw_calloc(s->remaining + 1, sizeof(double));
+	for (j = 0; j <= s->remaining; j++) {
+		binom[j] = s->remaining - j <= pool ?
+		           msw_solver_lchoose(pool, s->remaining - j) : -HUGE_VAL;
+		if (binom[j] > max)
+			max = binom[j];
+	}
+	for (j = 0; j <= s->remaining; j++)
+		binom[j] = exp(binom[j] - max);
+
+	all = msw_calloc(s->remaining + 1, sizeof(double));
+	tmp = msw_calloc(s->remaining + 1, sizeof(double));
+	all[0] = 1;
+	for (i = 0; i < ncomps; i++) {
+		n = msw_solver_convolve(all, n, s->count[comps[i]],
+		                        s->compsize[comps[i]] + 1, tmp,
+		                        s->remaining);
+		memcpy(all, tmp, n * sizeof(double));
+	}
+	for (j = 0; j < n; j++) {
+		total += all[j] * binom[j];
+		expected += all[j] * binom[j] * (s->remaining - j);
+	}
+	if (total > 0 && ncomps > 0) {
+		all[0] = 1;
+		msw_solver_split(s, comps, 0, ncomps, all, 1, binom);
+	}
+	free(binom);
+	free(all);
+	free(tmp);
+	return total > 0 ? expected / total : -1;
+}
+
+/*
+ * Estimate every cell's chance of being a mine: from the layouts where the CSP
+ * finished, heuristically elsewhere on the frontier, and from the mines left
+ * over off it.
+ */
+static void msw_solver_probabilities(struct msw_solver *s)
+{
+	msw *game = s->game;
+	int ncells = game->rows * game->columns;
+	double frontier = 0, pool, total, max, mines;
+	int *exact, nexact = 0, unconstrained = 0;
+	int i, k, n, v, comp;
+	struct msw_reservoir *r;
+
+	s->prob = msw_calloc(ncells, sizeof(double));
+	msw_ai_probabilities(game, s->prob);
+
+	exact = msw_calloc(s->ncomps, sizeof(int));
+	for (comp = 0; comp < s->ncomps; comp++)
+		if (s->complete[comp] && s->minesk[comp])
+			exact[nexact++] = comp;
+	pool = msw_solver_combine(s, exact, nexact);
+	if (pool < 0) {
+		// Weigh each component as if the rest of the board were
+		// unconstrained. Since the other components aren't, this
+		// slightly misjudges how many mines are left over.
+		for (i = 0; i < nexact; i++) {
+			comp = exact[i];
+			n = s->compsize[comp];
+			free(s->weight[comp]);
+			s->weight[comp] = msw_calloc(n + 1, sizeof(double));
+			max = -HUGE_VAL;
+			for (k = 0; k <= n; k++) {
+				s->weight[comp][k] =
+					k <= s->remaining &&
+					s->remaining - k <= s->unknown - n ?
+					msw_solver_lchoose(s->unknown - n,
+					                   s->remaining - k) :
+					-HUGE_VAL;
+				if (s->weight[comp][k] > max)
+					max = s->weight[comp][k];
+			}
+			for (k = 0; k <= n; k++)
+				s->weight[comp][k] = exp(s->weight[comp][k] - max);
+		}
+	}
+
+	for (i = 0; i < nexact; i++) {
+		comp = exact[i];
+		n = s->compsize[comp];
+		total = 0;
+		for (k = 0; k <= n; k++)
+			total += s->count[comp][k] * s->weight[comp][k];
+		for (v = 0; total > 0 && v < n; v++) {
+			mines = 0;
+			for (k = 0; k <= n; k++)
+				mines += s->minesk[comp][v * (n + 1) + k] *
+				         s->weight[comp][k];
+			s->prob[s->cell[s->order[s->compstart[comp] + v]]] =
+				mines / total;
+		}
+		r = &s->res[comp];
+		for (k = 0; k < r->n; k++)
+			r->cum[k] = (k ? r->cum[k - 1] : 0) +
+			            s->weight[comp][r->mines[k]];
+	}
+
+	// The other unknown cells share the mines the frontier doesn't hold.
+	for (i = 0; i < ncells; i++) {
+		if (MSW_CELL_VIS(game->cells[i]) != MSW_CUNKNOWN)
+			continue;
+		if (s->varof[i] >= 0)
+			frontier += s->prob[i];
+		else
+			unconstrained++;
+	}
+	if (pool >= 0) {
+		n = s->unknown;
+		for (i = 0; i < nexact; i++)
+			n -= s->compsize[exact[i]];
+		s->density = n ? pool / n : 0;
+	} else {
+		s->density = unconstrained ?
+		             (s->remaining - frontier) / unconstrained : 0;
+	}
+	free(exact);
+	if (s->density < 0)
+		s->density = 0;
+	if (s->density > 1)
+		s->density = 1;
+	for (i = 0; i < ncells; i++)
+		if (MSW_CELL_VIS(game->cells[i]) == MSW_CUNKNOWN &&
+		    s->varof[i] < 0)
+			s->prob[i] = s->density;
+}
+
+/*
+ * Return the unknown cell least likely to be a mine, or -1 if there is none.
+ */
+static int msw_solver_safest(struct msw_solver *s)
+{
+	int ncells = s->game->rows * s->game->columns;
+	int i, best = -1;
+
+	for (i = 0; i < ncells; i++)
+		if (MSW_CELL_VIS(s->game->cells[i]) == MSW_CUNKNOWN &&
+		    (best < 0 || s->prob[i] < s->prob[best]))
+			best = i;
+	return best;
+}
+
+/*
+ * Count the unknown neighbors of a cell.
+ */
+static int msw_solver_unknown_neighbors(msw *game, int cell)
+{
+	struct msw_loc loc = { cell / game->columns, cell % game->columns };
+	struct msw_loc neigh;
+	int iter, count = 0;
+
+	for_each_neigh(game, neigh, &loc, iter)
+		count += msw_get_visible(game, neigh) == MSW_UNKNOWN;
+	return count;
+}
+
+/*
+ * Pick the cells worth simulating a dig on, among the safest: frontier cells,
+ * and the cells off the frontier with the fewest unknown neighbors (which are
+ * the most likely to open up). Returns how many were put in cand.
+ */
+static int msw_solver_candidates(struct msw_solver *s, int safest, int *cand)
+{
+	msw *game = s->game;
+	int ncells = game->rows * game->columns;
+	double limit = s->prob[safest] + MSW_SOLVER_MARGIN;
+	int nfront = 0, nother = 0, i, j, c, u;
+	int other[MSW_SOLVER_OTHER_CANDIDATES];
+	int otheru[MSW_SOLVER_OTHER_CANDIDATES];
+
+	for (i = 0; i < ncells; i++) {
+		if (MSW_CELL_VIS(game->cells[i]) != MSW_CUNKNOWN ||
+		    s->prob[i] > limit)
+			continue;
+		if (s->varof[i] >= 0) {
+			// Keep the safest, in order.
+			if (nfront == MSW_SOLVER_FRONTIER_CANDIDATES &&
+			    s->prob[i] >= s->prob[cand[nfront - 1]])
+				continue;
+			if (nfront < MSW_SOLVER_FRONTIER_CANDIDATES)
+				nfront++;
+			for (j = nfront - 1; j > 0 && s->prob[cand[j - 1]] > s->prob[i]; j--)
+				cand[j] = cand[j - 1];
+			cand[j] = i;
+		} else {
+			// Keep those with the fewest unknown neighbors.
+			u = msw_solver_unknown_neighbors(game, i);
+			if (nother == MSW_SOLVER_OTHER_CANDIDATES &&
+			    u >= otheru[nother - 1])
+				continue;
+			if (nother < MSW_SOLVER_OTHER_CANDIDATES)
+				nother++;
+			for (j = nother - 1; j > 0 && otheru[j - 1] > u; j--) {
+				other[j] = other[j - 1];
+				otheru[j] = otheru[j - 1];
+			}
+			other[j] = i;
+			otheru[j] = u;
+		}
+	}
+	for (c = 0; c < nother; c++)
+		cand[nfront + c] = other[c];
+	return nfront + nother;
+}
+
+/*
+ * Pick one of a component's kept layouts, in proportion to its weight.
+ */
+static int msw_sampler_layout(struct msw_sampler *t, struct msw_reservoir *r)
+{
+	double x = msw_solver_uniform(&t->rng) * r->cum[r->n - 1];
+	int i;
+
+	if (r->cum[r->n - 1] <= 0)
+		return msw_solver_rand(&t->rng) % r->n;
+	for (i = 0; i < r->n - 1 && r->cum[i] < x; i++)
+		;
+	return i;
+}
+
+/*
+ * Whether a cell holds a mine in the sampler's current sample. Cells are only
+ * decided when they are looked at: complete components by picking one of their
+ * kept layouts, other cells by their estimated probability.
+ */
+static int msw_sampler_mine(struct msw_sampler *t, int cell)
+{
+	struct msw_solver *s = t->s;
+	int vis = MSW_CELL_VIS(s->game->cells[cell]);
+	int v = s->varof[cell], comp;
+	struct msw_reservoir *r;
+
+	if (vis == MSW_CFLAG || vis == MSW_CMINE)
+		return 1;
+	if (vis != MSW_CUNKNOWN)
+		return 0;
+	if (v >= 0 && s->weight[comp = s->varcomp[v]] && s->res[comp].n) {
+		r = &s->res[comp];
+		if (t->compstamp[comp] != t->sample) {
+			t->compstamp[comp] = t->sample;
+			t->choice[comp] = msw_sampler_layout(t, r);
+		}
+		return r->layouts[(size_t)t->choice[comp] * s->compsize[comp] +
+		                  s->varpos[v]];
+	}
+	if (t->cellstamp[cell] != t->sample) {
+		t->cellstamp[cell] = t->sample;
+		t->cellmine[cell] = msw_solver_uniform(&t->rng) <= s->prob[cell];
+	}
+	return t->cellmine[cell];
+}
+
+/*
+ * Simulate digging each candidate in one sampled board. A dig which survives
+ * opens up if none of its neighbors are mines either: flags and exploded mines
+ * count, along with whichever unknown ones the sample made mines.
+ */
+static void msw_sampler_step(struct msw_sampler *t)
+{
+	msw *game = t->s->game;
+	struct msw_loc loc, neigh;
+	int c, iter, cell, hidden;
+
+	t->sample++;
+	for (c = 0; c < t->ncand; c++) {
+		cell = t->cand[c];
+		if (msw_sampler_mine(t, cell))
+			continue;
+		t->safe[c] += 1;
+		loc.row = cell / game->columns;
+		loc.col = cell % game->columns;
+		hidden = 0;
+		for_each_neigh(game, neigh, &loc, iter)
+		{
+			if (msw_sampler_mine(t, msw_index(game, neigh.row,
+			                                  neigh.col)))
+				hidden++;
+		}
+		t->opens[c] += hidden == 0;
+	}
+}
+
+static void *msw_sampler_run(void *arg)
+{
+	struct msw_sampler *t = arg;
+	long i;
+
+	msw_trace_begin("sampler", t->samples);
+	for (i = 0; i < t->samples; i++) {
+		if (i % 64 == 63 && msw_solver_timeout(t->s))
+			break;
+		msw_sampler_step(t);
+	}
+	msw_trace_end("sampler");
+	return NULL;
+}
+
+/*
+ * Choose among the candidates by sampling boards on as many threads as the
+ * budget allows. Returns the index of the best candidate.
+ */
+static int msw_solver_sample(struct msw_solver *s, const int *cand, int ncand)
+{
+	int nthreads = s->budget->threads > 1 ? s->budget->threads : 1;
+	int ncells = s->game->rows * s->game->columns;
+	struct msw_sampler *t = msw_calloc(nthreads, sizeof(*t));
+	double safe[MSW_SOLVER_CANDIDATES] = { 0 };
+	double opens[MSW_SOLVER_CANDIDATES] = { 0 };
+	double score, best = -1;
+	int i, c, choice = 0;
+
+	for (i = 0; i < nthreads; i++) {
+		t[i].s = s;
+		t[i].rng = s->rng ^ (0xD1B54A32D192ED03ULL * (i + 1));
+		t[i].samples = s->budget->samples / nthreads +
+		               (i < s->budget->samples % nthreads);
+		t[i].ncand = ncand;
+		t[i].cand = cand;
+		t[i].cellstamp = msw_calloc(ncells, sizeof(int));
+		t[i].cellmine = msw_calloc(ncells, 1);
+		t[i].compstamp = msw_calloc(s->ncomps, sizeof(int));
+		t[i].choice = msw_calloc(s->ncomps, sizeof(int));
+	}
+	// The calling thread does the first share itself.
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&t[i].thread, NULL, msw_sampler_run, &t[i]) != 0)
+			t[i].samples = -1;
+	}
+	msw_sampler_run(&t[0]);
+	for (i = 0; i < nthreads; i++) {
+		if (i > 0 && t[i].samples >= 0)
+			pthread_join(t[i].thread, NULL);
+		for (c = 0; c < ncand; c++) {
+			safe[c] += t[i].safe[c];
+			opens[c] += t[i].opens[c];
+		}
+		free(t[i].cellstamp);
+		free(t[i].cellmine);
+		free(t[i].compstamp);
+		free(t[i].choice);
+	}
+	free(t);
+
+	// The candidates are equally safe, so prefer the one most likely to
+	// open up when it is.
+	for (c = 0; c < ncand; c++) {
+		if (safe[c] == 0)
+			continue;
+		score = opens[c] / safe[c];
+		if (score > best) {
+			best = score;
+			choice = c;
+		}
+	}
+	return choice;
+}
+
+/*
+ * Dig the unknown cell most worth guessing. Sets *stage to the stage which
+ * chose it, and *confidence to the chance that it is safe.
+ */
+static struct msw_ai_move msw_solver_guess(struct msw_solver *s, int *stage,
+                                           double *confidence)
+{
+	msw *game = s->game;
+	int cand[MSW_SOLVER_CANDIDATES];
+	int cell, ncand;
+	struct msw_ai_move move = {
+		.action = AI_NONE,
+		.loc = { .row = 0, .col = 0 },
+		.description = "I'm stumped!",
+	};
+
+	msw_trace_begin("probabilities", -1);
+	msw_solver_probabilities(s);
+	msw_trace_end("probabilities");
+	cell = msw_solver_safest(s);
+	if (cell < 0)
+		return move;
+	move.description = "Dig (least likely to be a mine)";
+	*stage = MSW_AI_GUESS;
+
+	if (s->budget->samples > 0 && !msw_solver_timeout(s)) {
+		ncand = msw_solver_candidates(s, cell, cand);
+		if (ncand > 1) {
+			msw_trace_begin("sample", ncand);
+			cell = cand[msw_solver_sample(s, cand, ncand)];
+			msw_trace_end("sample");
+			move.description = "Dig (best guess in sampled boards)";
+			*stage = MSW_AI_SAMPLE;
+		}
+	}
+
+	move.action = AI_DIG;
+	move.loc.row = cell / game->columns;
+	move.loc.col = cell % game->columns;
+	*confidence = 1.0 - s->prob[cell];
+	return move;
+}
+
+static void msw_solver_free(struct msw_solver *s)
+{
+	int i;
+
+	free(s->varof);
+	free(s->cell);
+	free(s->cons);
+	free(s->varcons);
+	free(s->nvarcons);
+	free(s->order);
+	free(s->compstart);
+	free(s->compsize);
+	free(s->complete);
+	free(s->mines);
+	free(s->prob);
+	free(s->varcomp);
+	free(s->varpos);
+	for (i = 0; i < s->ncomps; i++) {
+		free(s->count[i]);
+		free(s->minesk[i]);
+		free(s->weight[i]);
+		free(s->res[i].mines);
+		free(s->res[i].cum);
+		free(s->res[i].layouts);
+	}
+	free(s->count);
+	free(s->minesk);
+	free(s->weight);
+	free(s->res);
+}
+
+/**
+ * @brief Find the best move possible within a budget.
+ * @param game The game.
+ * @param budget Limits on the solver's work (NULL for none). Deductions and
+ * the final guess are always made; only the CSP stage is cut short.
+ * @param report If not NULL, receives details of the move. Its answered
+ * counters are added to, so they may be kept over many calls.
+ * @returns A move, which is AI_NONE only if there are no unknown cells.
+ */
+struct msw_ai_move msw_ai_anytime(msw *game, const struct msw_ai_budget *budget,
+                                  struct msw_ai_report *report)
+{
+	static const struct msw_ai_budget unlimited = { 0 };
+	struct msw_solver s = { 0 };
+	struct msw_ai_move move;
+	double confidence = 1.0;
+	struct msw_counts counts;
+	int stage = MSW_AI_SIMPLE;
+	uint64_t start = msw_stats_begin(game);
+
+	msw_trace_begin("ai_anytime", -1);
+
+	s.game = game;
+	s.budget = budget ? budget : &unlimited;
+	s.rng = game->seed ^ 0x5DEECE66DULL; /* same board, same guesses */
+	s.deadline = msw_stats_deadline(s.budget->seconds);
+
+	move = msw_ai_deduce(game, &stage);
+	if (move.action != AI_NONE)
+		goto done;
+
+	s.remaining = game->mines - game->flags;
+	msw_count(game, &counts);
+
+	if (!counts.revealed &&
+	    msw_vcell(game, game->rows / 2, game->columns / 2) == MSW_UNKNOWN) {
+		// Nothing to go on. The middle opens up the most, and if the
+		// grid doesn't exist yet, the first dig is never a mine.
+		move.action = AI_DIG;
+		move.loc.row = game->rows / 2;
+		move.loc.col = game->columns / 2;
+		move.description = "Dig (nothing revealed yet)";
+		if (game->has_grid)
+			confidence = 1 - (double)s.remaining / counts.unknown;
+		stage = MSW_AI_GUESS;
+		if (game->stats)
+			game->stats->ai_stage[MSW_AI_GUESS]++;
+		goto done;
+	}
+
+	msw_trace_begin("frontier", -1);
+	msw_solver_build(&s);
+	msw_solver_components(&s);
+	msw_trace_end("frontier");
+	s.mines = msw_calloc(s.nvars, sizeof(double));
+
+	s.unknown = counts.unknown;
+	stage = MSW_AI_CSP;
+	if (game->stats)
+		game->stats->ai_stage[MSW_AI_CSP]++;
+	msw_trace_begin("csp", s.ncomps);
+	move = msw_solver_csp(&s);
+	msw_trace_end("csp");
+	if (move.action == AI_NONE) {
+		msw_trace_begin("guess", -1);
+		move = msw_solver_guess(&s, &stage, &confidence);
+		msw_trace_end("guess");
+		if (game->stats)
+			game->stats->ai_stage[stage]++;
+	}
+	msw_solver_free(&s);
+
+done:
+	if (report) {
+		report->confidence = move.action == AI_NONE ? 0.0 : confidence;
+		report->stage = stage;
+		report->complete = !s.stopped;
+		report->nodes = s.nodes;
+		if (move.action != AI_NONE)
+			report->answered[stage]++;
+	}
+	msw_trace_end("ai_anytime");
+	msw_stats_end(game, MSW_CALL_ANYTIME, start);
+	return move;
+}
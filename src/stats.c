@@ -0,0 +1,239 @@
+/***************************************************************************//**
+
+  @file         stats.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Counters and latency histograms of a game's engine calls.
+
+  A game only counts while its statistics are enabled, and the engine checks
+  for them with a single test of a pointer, so they cost next to nothing when
+  they're off.  Sizes and latencies go in histograms with a bucket per power of
+  two, which are cheap to fill and to add up across games.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minesweeper.h"
+
+static const char *call_names[MSW_NCALLS] = {
+	"dig", "flag", "unflag", "reveal", "undo", "redo", "won", "ai",
+	"ai_anytime",
+};
+
+static const char *stage_names[MSW_AI_NSTAGES] = {
+	"simple", "groups", "csp", "sample", "guess",
+};
+
+/*
+ * The bucket of a value: 0 holds 0, and bucket b > 0 holds 2^(b-1) up to
+ * 2^b - 1.
+ */
+static int msw_stats_bucket(uint64_t v)
+{
+	int b = v ? 64 - __builtin_clzll(v) : 0;
+	return b < MSW_STATS_BUCKETS ? b : MSW_STATS_BUCKETS - 1;
+}
+
+/**
+ * @brief Start or stop counting a game's statistics.
+ *
+ * Enabling them starts from zero; disabling them throws them away.
+ */
+void msw_stats_enable(msw *game, int enable)
+{
+	free(game->stats);
+	game->stats = NULL;
+	if (enable) {
+		game->stats = calloc(1, sizeof(struct msw_stats));
+		if (game->stats == NULL) {
+			fprintf(stderr, "error: calloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/**
+ * @brief Return a game's statistics, or NULL if they aren't enabled.
+ */
+const struct msw_stats *msw_stats_get(msw *game)
+{
+	return game->stats;
+}
+
+/**
+ * @brief Zero a game's statistics, if they are enabled.
+ */
+void msw_stats_reset(msw *game)
+{
+	if (game->stats)
+		memset(game->stats, 0, sizeof(struct msw_stats));
+}
+
+/**
+ * @brief Add one set of statistics to another, e.g. to total many games.
+ */
+void msw_stats_add(struct msw_stats *to, const struct msw_stats *from)
+{
+	int i, b;
+
+	to->digs += from->digs;
+	to->uncovered += from->uncovered;
+	to->floods += from->floods;
+	to->flooded += from->flooded;
+	to->marks += from->marks;
+	to->undo_entries += from->undo_entries;
+	for (i = 0; i < MSW_AI_NSTAGES; i++)
+		to->ai_stage[i] += from->ai_stage[i];
+	for (b = 0; b < MSW_STATS_BUCKETS; b++) {
+		to->dig_sizes[b] += from->dig_sizes[b];
+		to->flood_sizes[b] += from->flood_sizes[b];
+	}
+	for (i = 0; i < MSW_NCALLS; i++) {
+		to->calls[i].calls += from->calls[i].calls;
+		to->calls[i].total_ns += from->calls[i].total_ns;
+		if (from->calls[i].max_ns > to->calls[i].max_ns)
+			to->calls[i].max_ns = from->calls[i].max_ns;
+		for (b = 0; b < MSW_STATS_BUCKETS; b++)
+			to->calls[i].buckets[b] += from->calls[i].buckets[b];
+	}
+}
+
+/**
+ * @brief Read the clock used for latencies, in nanoseconds.
+ */
+uint64_t msw_stats_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief The reading of msw_stats_clock() a number of seconds from now.
+ * @returns The deadline, or 0 (no deadline) if seconds isn't positive.
+ */
+uint64_t msw_stats_deadline(double seconds)
+{
+	if (seconds <= 0)
+		return 0;
+	return msw_stats_clock() + (uint64_t)(seconds * 1e9);
+}
+
+/**
+ * @brief Count a call which started at the given time (see msw_stats_end()).
+ */
+void msw_stats_call(struct msw_stats *stats, int call, uint64_t start)
+{
+	struct msw_latency *l = &stats->calls[call];
+	uint64_t ns = msw_stats_clock() - start;
+
+	l->calls++;
+	l->total_ns += ns;
+	if (ns > l->max_ns)
+		l->max_ns = ns;
+	l->buckets[msw_stats_bucket(ns)]++;
+}
+
+/**
+ * @brief Count a dig which uncovered n cells, and whether it was an opening.
+ */
+void msw_stats_dig(struct msw_stats *stats, int n, int flood)
+{
+	stats->digs++;
+	stats->uncovered += n;
+	stats->dig_sizes[msw_stats_bucket(n)]++;
+	if (flood) {
+		stats->floods++;
+		stats->flooded += n;
+		stats->flood_sizes[msw_stats_bucket(n)]++;
+	}
+}
+
+/*
+ * The upper end of the bucket where a fraction p of the calls are reached, or
+ * the slowest call if that is lower.
+ */
+static uint64_t msw_stats_quantile(const struct msw_latency *l, double p)
+{
+	uint64_t seen = 0, ns;
+	int b;
+
+	for (b = 0; b < MSW_STATS_BUCKETS; b++) {
+		seen += l->buckets[b];
+		if (seen > 0 && seen >= p * l->calls)
+			break;
+	}
+	ns = b ? ((uint64_t)1 << b) - 1 : 0;
+	return ns < l->max_ns ? ns : l->max_ns;
+}
+
+static void msw_stats_print_sizes(FILE *stream, const char *what,
+                                  const uint64_t *buckets)
+{
+	int b;
+
+	fprintf(stream, "%s:", what);
+	for (b = 0; b < MSW_STATS_BUCKETS; b++) {
+		if (buckets[b] == 0)
+			continue;
+		if (b < 2)
+			fprintf(stream, " %d:%llu", b,
+			        (unsigned long long)buckets[b]);
+		else
+			fprintf(stream, " %llu-%llu:%llu", 1ULL << (b - 1),
+			        (1ULL << b) - 1,
+			        (unsigned long long)buckets[b]);
+	}
+	fputc('\n', stream);
+}
+
+/**
+ * @brief Print a set of statistics in a readable form.
+ *
+ * Latency percentiles are the upper ends of their power of two buckets, so
+ * they may be up to twice the real ones.
+ */
+void msw_stats_print(const struct msw_stats *stats, FILE *stream)
+{
+	const struct msw_latency *l;
+	int i;
+
+	fprintf(stream, "digs: %llu, uncovering %llu cells (%llu openings, "
+	        "%llu cells)\n", (unsigned long long)stats->digs,
+	        (unsigned long long)stats->uncovered,
+	        (unsigned long long)stats->floods,
+	        (unsigned long long)stats->flooded);
+	msw_stats_print_sizes(stream, "cells per dig", stats->dig_sizes);
+	msw_stats_print_sizes(stream, "cells per opening", stats->flood_sizes);
+	fprintf(stream, "ai passes:");
+	for (i = 0; i < MSW_AI_NSTAGES; i++)
+		fprintf(stream, " %s %llu", stage_names[i],
+		        (unsigned long long)stats->ai_stage[i]);
+	fprintf(stream, "\nai marks: %llu\nundo entries: %llu\n",
+	        (unsigned long long)stats->marks,
+	        (unsigned long long)stats->undo_entries);
+
+	fprintf(stream, "%-10s %10s %10s %10s %10s %10s %10s\n", "call",
+	        "calls", "mean ns", "p50 ns", "p90 ns", "p99 ns", "max ns");
+	for (i = 0; i < MSW_NCALLS; i++) {
+		l = &stats->calls[i];
+		if (l->calls == 0)
+			continue;
+		fprintf(stream, "%-10s %10llu %10.0f %10llu %10llu %10llu "
+		        "%10llu\n", call_names[i], (unsigned long long)l->calls,
+		        (double)l->total_ns / l->calls,
+		        (unsigned long long)msw_stats_quantile(l, .5),
+		        (unsigned long long)msw_stats_quantile(l, .9),
+		        (unsigned long long)msw_stats_quantile(l, .99),
+		        (unsigned long long)l->max_ns);
+	}
+}
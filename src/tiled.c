@@ -0,0 +1,419 @@
+/***************************************************************************//**
+
+  @file         tiled.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Boards too big to allocate, stored as the tiles played on.
+
+  A msw_tiled board never holds a grid.  Whether a cell is a mine is a hash of
+  the seed and the cell's position, so any cell's number can be worked out
+  from its neighbors wherever they are, including across the edges of tiles.
+  The visible board is split into MSW_TILE x MSW_TILE tiles, kept in an open
+  addressing hash table and allocated the first time one of their cells is
+  uncovered or flagged.  Unallocated tiles are entirely unknown, so memory is
+  proportional to the area explored, not to the board.
+
+  The three by three block around the first dig never holds a mine, so that
+  the first dig always opens up.  With a density under about one mine in ten,
+  openings may grow without bound, so msw_tiled_init() refuses those.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minesweeper.h"
+
+#define MSW_TILE_CELLS (MSW_TILE * MSW_TILE)
+
+struct msw_tile {
+	int64_t row, col; /* position, in tiles */
+	char visible[MSW_TILE_CELLS];
+};
+
+/**
+ * @brief Set up a board of the given size and mine density.
+ * @param density Chance that a cell is a mine, between MSW_TILED_MIN_DENSITY
+ * and 1.
+ * @param seed Seed of the layout of mines, or 0 to pick one.
+ * @returns 0 on success, -1 if the size or density is out of range.
+ */
+int msw_tiled_init(msw_tiled *b, int64_t rows, int64_t columns,
+                   double density, uint64_t seed)
+{
+	memset(b, 0, sizeof(*b));
+	if (rows <= 0 || columns <= 0 || rows > MSW_TILED_MAX ||
+	    columns > MSW_TILED_MAX || density < MSW_TILED_MIN_DENSITY ||
+	    density >= 1)
+		return -1;
+	b->rows = rows;
+	b->columns = columns;
+	b->seed = seed ? seed : (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)b;
+	b->threshold = (uint64_t)(density * 18446744073709551616.0);
+	b->first_row = b->first_col = -1;
+	return 0;
+}
+
+/**
+ * @brief Free a board's tiles.
+ */
+void msw_tiled_destroy(msw_tiled *b)
+{
+	size_t i;
+
+	for (i = 0; i < b->tilecap; i++)
+		free(b->tiles[i]);
+	free(b->tiles);
+	free(b->stack);
+	b->tiles = NULL;
+	b->stack = NULL;
+	b->ntiles = b->tilecap = b->stackcap = 0;
+}
+
+/*
+ * Mix a position into the seed (the splitmix64 finalizer).
+ */
+static inline uint64_t msw_tiled_hash(uint64_t seed, int64_t a, int64_t b)
+{
+	uint64_t z = seed ^ (uint64_t)a * 0x9E3779B97F4A7C15ULL ^
+	             (uint64_t)b * 0xC2B2AE3D27D4EB4FULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline int msw_tiled_in_bounds(msw_tiled *b, int64_t r, int64_t c)
+{
+	return r >= 0 && r < b->rows && c >= 0 && c < b->columns;
+}
+
+/*
+ * Whether an in-bounds cell is a mine. Only call once the first dig is made.
+ */
+static inline int msw_tiled_mine(msw_tiled *b, int64_t r, int64_t c)
+{
+	if (r - b->first_row <= 1 && b->first_row - r <= 1 &&
+	    c - b->first_col <= 1 && b->first_col - c <= 1)
+		return 0;
+	return msw_tiled_hash(b->seed, r, c) < b->threshold;
+}
+
+static int msw_tiled_number(msw_tiled *b, int64_t r, int64_t c)
+{
+	int i, n = 0;
+
+	for (i = 0; i < NUM_NEIGHBORS; i++) {
+		if (msw_tiled_in_bounds(b, r + rnbr[i], c + cnbr[i]) &&
+		    msw_tiled_mine(b, r + rnbr[i], c + cnbr[i]))
+			n++;
+	}
+	return n;
+}
+
+static inline size_t msw_tiled_slot(msw_tiled *b, int64_t tr, int64_t tc)
+{
+	return msw_tiled_hash(0, tr, tc) & (b->tilecap - 1);
+}
+
+static void msw_tiled_grow(msw_tiled *b)
+{
+	struct msw_tile **old = b->tiles;
+	size_t i, j, oldcap = b->tilecap;
+
+	b->tilecap = oldcap ? oldcap * 2 : 64;
+	b->tiles = calloc(b->tilecap, sizeof(struct msw_tile *));
+	if (b->tiles == NULL) {
+		fprintf(stderr, "error: calloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < oldcap; i++) {
+		if (old[i] == NULL)
+			continue;
+		j = msw_tiled_slot(b, old[i]->row, old[i]->col);
+		while (b->tiles[j])
+			j = (j + 1) & (b->tilecap - 1);
+		b->tiles[j] = old[i];
+	}
+	free(old);
+}
+
+/*
+ * Find the tile holding a cell, allocating it (all unknown) if create is set.
+ * Returns NULL if it doesn't exist and create isn't set.
+ */
+static struct msw_tile *msw_tiled_tile(msw_tiled *b, int64_t r, int64_t c,
+                                       int create)
+{
+	int64_t tr = r >> MSW_TILE_BITS, tc = c >> MSW_TILE_BITS;
+	struct msw_tile *tile;
+	size_t i;
+
+	if (b->tilecap) {
+		i = msw_tiled_slot(b, tr, tc);
+		for (; b->tiles[i]; i = (i + 1) & (b->tilecap - 1)) {
+			if (b->tiles[i]->row == tr && b->tiles[i]->col == tc)
+				return b->tiles[i];
+		}
+	}
+	if (!create)
+		return NULL;
+
+	if (2 * (b->ntiles + 1) > b->tilecap)
+		msw_tiled_grow(b);
+	tile = malloc(sizeof(struct msw_tile));
+	if (tile == NULL) {
+		fprintf(stderr, "error: malloc() returned null.\n");
+		exit(EXIT_FAILURE);
+	}
+	tile->row = tr;
+	tile->col = tc;
+	memset(tile->visible, MSW_UNKNOWN, MSW_TILE_CELLS);
+	i = msw_tiled_slot(b, tr, tc);
+	while (b->tiles[i])
+		i = (i + 1) & (b->tilecap - 1);
+	b->tiles[i] = tile;
+	b->ntiles++;
+	return tile;
+}
+
+static inline int msw_tiled_offset(int64_t r, int64_t c)
+{
+	return (r & (MSW_TILE - 1)) * MSW_TILE + (c & (MSW_TILE - 1));
+}
+
+/**
+ * @brief Return the visible state of a cell, or 0 if it is out of bounds.
+ */
+char msw_tiled_get(msw_tiled *b, int64_t r, int64_t c)
+{
+	struct msw_tile *tile;
+
+	if (!msw_tiled_in_bounds(b, r, c))
+		return 0;
+	tile = msw_tiled_tile(b, r, c, 0);
+	return tile ? tile->visible[msw_tiled_offset(r, c)] : MSW_UNKNOWN;
+}
+
+static void msw_tiled_set(msw_tiled *b, int64_t r, int64_t c, char val)
+{
+	msw_tiled_tile(b, r, c, 1)->visible[msw_tiled_offset(r, c)] = val;
+}
+
+static void msw_tiled_push(msw_tiled *b, size_t *n, int64_t r, int64_t c)
+{
+	if (*n + 2 > b->stackcap) {
+		b->stackcap = b->stackcap ? b->stackcap * 2 : 1024;
+		b->stack = realloc(b->stack, b->stackcap * sizeof(int64_t));
+		if (b->stack == NULL) {
+			fprintf(stderr, "error: realloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	b->stack[(*n)++] = r;
+	b->stack[(*n)++] = c;
+}
+
+/*
+ * Dig an in-bounds cell after the first dig, uncovering the whole opening if
+ * it is clear.
+ */
+static int msw_tiled_dig_cell(msw_tiled *b, int64_t r, int64_t c)
+{
+	size_t n = 0;
+	int i, number;
+	char vis = msw_tiled_get(b, r, c);
+
+	if (vis == MSW_FLAG)
+		return MSW_FLAGGED;
+	if (vis != MSW_UNKNOWN)
+		return MSW_MMOVE;
+	if (msw_tiled_mine(b, r, c)) {
+		msw_tiled_set(b, r, c, MSW_MINE);
+		return MSW_MBOOM;
+	}
+
+	msw_trace_begin("tiled opening", -1);
+	msw_tiled_push(b, &n, r, c);
+	while (n) {
+		c = b->stack[--n];
+		r = b->stack[--n];
+		if (msw_tiled_get(b, r, c) != MSW_UNKNOWN)
+			continue;
+		number = msw_tiled_number(b, r, c);
+		msw_tiled_set(b, r, c, '0' + number);
+		b->uncovered++;
+		if (number)
+			continue;
+		for (i = 0; i < NUM_NEIGHBORS; i++) {
+			if (msw_tiled_get(b, r + rnbr[i], c + cnbr[i]) ==
+			    MSW_UNKNOWN)
+				msw_tiled_push(b, &n, r + rnbr[i], c + cnbr[i]);
+		}
+	}
+	msw_trace_end("tiled opening");
+	return MSW_MMOVE;
+}
+
+/**
+ * @brief Dig at a cell. The first dig always lands in an opening.
+ */
+int msw_tiled_dig(msw_tiled *b, int64_t r, int64_t c)
+{
+	if (!msw_tiled_in_bounds(b, r, c))
+		return MSW_MBOUND;
+	if (b->first_row < 0) {
+		b->first_row = r;
+		b->first_col = c;
+	}
+	return msw_tiled_dig_cell(b, r, c);
+}
+
+/**
+ * @brief Stick a flag in an unknown cell.
+ */
+int msw_tiled_flag(msw_tiled *b, int64_t r, int64_t c)
+{
+	if (!msw_tiled_in_bounds(b, r, c))
+		return MSW_MBOUND;
+	if (msw_tiled_get(b, r, c) != MSW_UNKNOWN)
+		return MSW_MFLAGERR;
+	msw_tiled_set(b, r, c, MSW_FLAG);
+	b->flags++;
+	return MSW_MMOVE;
+}
+
+/**
+ * @brief Remove a flag.
+ */
+int msw_tiled_unflag(msw_tiled *b, int64_t r, int64_t c)
+{
+	if (!msw_tiled_in_bounds(b, r, c))
+		return MSW_MBOUND;
+	if (msw_tiled_get(b, r, c) != MSW_FLAG)
+		return MSW_MUNFLAGERR;
+	msw_tiled_set(b, r, c, MSW_UNKNOWN);
+	b->flags--;
+	return MSW_MMOVE;
+}
+
+/**
+ * @brief Dig every neighbor of a number with at least as many flags around
+ * it, like msw_reveal().
+ */
+int msw_tiled_reveal(msw_tiled *b, int64_t r, int64_t c)
+{
+	int i, rv, nflags = 0;
+	char val;
+
+	if (!msw_tiled_in_bounds(b, r, c))
+		return MSW_MBOUND;
+	val = msw_tiled_get(b, r, c);
+	if (val < '0' || val > '8')
+		return MSW_MREVEALHF;
+	for (i = 0; i < NUM_NEIGHBORS; i++) {
+		if (msw_tiled_get(b, r + rnbr[i], c + cnbr[i]) == MSW_FLAG)
+			nflags++;
+	}
+	if (nflags < val - '0')
+		return MSW_MREVEALN;
+	for (i = 0; i < NUM_NEIGHBORS; i++) {
+		if (!msw_tiled_in_bounds(b, r + rnbr[i], c + cnbr[i]))
+			continue;
+		rv = msw_tiled_dig_cell(b, r + rnbr[i], c + cnbr[i]);
+		if (!MSW_MOK(rv))
+			return rv;
+	}
+	return MSW_MMOVE;
+}
+
+/**
+ * @brief Bytes used by the board's tiles and bookkeeping.
+ */
+size_t msw_tiled_memory(msw_tiled *b)
+{
+	return b->ntiles * sizeof(struct msw_tile) +
+	       b->tilecap * sizeof(struct msw_tile *) +
+	       b->stackcap * sizeof(int64_t);
+}
+
+/**
+ * @brief Print the part of the board with the given corner and size.
+ */
+void msw_tiled_print(msw_tiled *b, int64_t row, int64_t col, int64_t rows,
+                     int64_t cols, FILE *stream)
+{
+	int64_t r, c;
+
+	for (r = row; r < row + rows && r < b->rows; r++) {
+		fprintf(stream, "%12lld | ", (long long)r);
+		for (c = col; c < col + cols && c < b->columns; c++)
+			fputc(msw_tiled_get(b, r, c), stream);
+		fputc('\n', stream);
+	}
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-s SEED] [-d DENSITY] ROWS COLUMNS ROW COL "
+	       "[ROW COL]...\n", name);
+	printf("\tDig the given cells of a board too big to allocate, and "
+	       "report the\n\tmemory used.  The first dig always opens up.\n");
+	printf("\t-s: seed of the layout of mines\n");
+	printf("\t-d: chance that a cell is a mine (default 0.15)\n");
+}
+
+/**
+ * @brief Explore a huge tiled board from the command line.
+ */
+int tiled_main(int argc, char **argv)
+{
+	msw_tiled b;
+	double density = 0.15;
+	uint64_t seed = 0;
+	int64_t rows, columns, r = 0, c = 0;
+	int i, rv = MSW_MMOVE;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			density = atof(argv[++i]);
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc - i < 4 || (argc - i) % 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	rows = strtoll(argv[i], NULL, 10);
+	columns = strtoll(argv[i + 1], NULL, 10);
+	if (msw_tiled_init(&b, rows, columns, density, seed) < 0) {
+		fprintf(stderr, "error: bad board (%lldx%lld, at most %lld on "
+		        "a side, density %g, at least %g)\n", (long long)rows,
+		        (long long)columns, (long long)MSW_TILED_MAX, density,
+		        MSW_TILED_MIN_DENSITY);
+		return EXIT_FAILURE;
+	}
+
+	for (i += 2; i < argc && MSW_MOK(rv); i += 2) {
+		r = strtoll(argv[i], NULL, 10);
+		c = strtoll(argv[i + 1], NULL, 10);
+		rv = msw_tiled_dig(&b, r, c);
+		printf("dig (%lld, %lld): %s\n", (long long)r, (long long)c,
+		       MSW_MSG[rv]);
+	}
+	msw_tiled_print(&b, r > 10 ? r - 10 : 0, c > 30 ? c - 30 : 0, 21, 61,
+	                stdout);
+	printf("seed %llu: %lld cells uncovered, %zu tiles, %zu bytes\n",
+	       (unsigned long long)b.seed, (long long)b.uncovered, b.ntiles,
+	       msw_tiled_memory(&b));
+	msw_tiled_destroy(&b);
+	return MSW_MOK(rv) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,220 @@
+/***************************************************************************//**
+
+  @file         trace.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Begin/end events of the engine, in Chrome's trace format.
+
+  Build with -DMSW_TRACE (make TRACE=1) to record when generation, openings,
+  each AI stage and each solver component start and finish.  Otherwise the
+  trace macros in minesweeper.h are empty and nothing here is compiled but a
+  msw_trace_dump() which says so.
+
+  Each thread records into a ring of its own, so recording takes no lock: the
+  owner is the only writer, and publishes each event by advancing the ring's
+  head.  Rings are pushed onto a global list the first time a thread records,
+  and are reused by later threads once their owner exits, so the sampler's
+  short lived threads don't pile up rings.  A full ring overwrites its oldest
+  events.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "minesweeper.h"
+
+#ifdef MSW_TRACE
+
+#include <pthread.h>
+
+/* Events kept by each thread (a power of two). */
+#define MSW_TRACE_EVENTS (1 << 14)
+
+struct msw_trace_event {
+	uint64_t ns;
+	const char *name;
+	long arg;
+	int tid;
+	char phase; /* 'B' or 'E' */
+};
+
+struct msw_trace_ring {
+	struct msw_trace_ring *next;
+	int owned;     /* nonzero while a thread records here */
+	uint64_t head; /* events ever recorded */
+	struct msw_trace_event events[MSW_TRACE_EVENTS];
+};
+
+static struct msw_trace_ring *msw_trace_rings;
+static int msw_trace_tids;
+static pthread_key_t msw_trace_key;
+static pthread_once_t msw_trace_once = PTHREAD_ONCE_INIT;
+static __thread struct msw_trace_ring *msw_trace_self;
+static __thread int msw_trace_tid;
+
+/*
+ * When a thread exits, let the next new thread have its ring.
+ */
+static void msw_trace_release(void *arg)
+{
+	struct msw_trace_ring *ring = arg;
+	__atomic_store_n(&ring->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void msw_trace_init(void)
+{
+	pthread_key_create(&msw_trace_key, msw_trace_release);
+}
+
+static struct msw_trace_ring *msw_trace_claim(void)
+{
+	struct msw_trace_ring *ring;
+	int unowned;
+
+	pthread_once(&msw_trace_once, msw_trace_init);
+	msw_trace_tid = __atomic_add_fetch(&msw_trace_tids, 1,
+	                                   __ATOMIC_RELAXED);
+
+	ring = __atomic_load_n(&msw_trace_rings, __ATOMIC_ACQUIRE);
+	for (; ring; ring = ring->next) {
+		unowned = 0;
+		if (__atomic_compare_exchange_n(&ring->owned, &unowned, 1, 0,
+		                                __ATOMIC_ACQUIRE,
+		                                __ATOMIC_RELAXED))
+			break;
+	}
+	if (ring == NULL) {
+		ring = calloc(1, sizeof(struct msw_trace_ring));
+		if (ring == NULL) {
+			fprintf(stderr, "error: calloc() returned null.\n");
+			exit(EXIT_FAILURE);
+		}
+		ring->owned = 1;
+		ring->next = __atomic_load_n(&msw_trace_rings,
+		                             __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&msw_trace_rings,
+		                                    &ring->next, ring, 1,
+		                                    __ATOMIC_RELEASE,
+		                                    __ATOMIC_RELAXED))
+			;
+	}
+	pthread_setspecific(msw_trace_key, ring);
+	return ring;
+}
+
+/**
+ * @brief Record an event on the calling thread (see msw_trace_begin()).
+ * @param name A string which outlives the trace, normally a literal.
+ * @param phase 'B' to begin a span, 'E' to end it.
+ * @param arg Shown with the event unless it is negative.
+ */
+void msw_trace_event(const char *name, int phase, long arg)
+{
+	struct msw_trace_ring *ring = msw_trace_self;
+	struct msw_trace_event *ev;
+	struct timespec ts;
+
+	if (ring == NULL)
+		ring = msw_trace_self = msw_trace_claim();
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ev = &ring->events[ring->head & (MSW_TRACE_EVENTS - 1)];
+	ev->ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	ev->name = name;
+	ev->arg = arg;
+	ev->tid = msw_trace_tid;
+	ev->phase = phase;
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Write every thread's recorded events as Chrome trace JSON.
+ *
+ * The file loads in chrome://tracing or Perfetto.  Call it while no other
+ * thread is recording, or their newest events may be torn.
+ * @returns 0 on success, -1 on failure (with a message on stderr).
+ */
+int msw_trace_dump(const char *path)
+{
+	struct msw_trace_ring *ring;
+	struct msw_trace_event *ev;
+	uint64_t i, head, first = 0;
+	const char *sep = "";
+	FILE *f;
+
+	f = fopen(path, "w");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	ring = __atomic_load_n(&msw_trace_rings, __ATOMIC_ACQUIRE);
+	for (; ring; ring = ring->next) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		i = head > MSW_TRACE_EVENTS ? head - MSW_TRACE_EVENTS : 0;
+		for (; i < head; i++) {
+			ev = &ring->events[i & (MSW_TRACE_EVENTS - 1)];
+			if (first == 0 || ev->ns < first)
+				first = ev->ns;
+		}
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	ring = __atomic_load_n(&msw_trace_rings, __ATOMIC_ACQUIRE);
+	for (; ring; ring = ring->next) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		i = head > MSW_TRACE_EVENTS ? head - MSW_TRACE_EVENTS : 0;
+		for (; i < head; i++) {
+			ev = &ring->events[i & (MSW_TRACE_EVENTS - 1)];
+			fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\","
+			        "\"ts\":%.3f,\"pid\":1,\"tid\":%d", sep,
+			        ev->name, ev->phase, (ev->ns - first) / 1e3,
+			        ev->tid);
+			if (ev->arg >= 0)
+				fprintf(f, ",\"args\":{\"n\":%ld}", ev->arg);
+			fputc('}', f);
+			sep = ",";
+		}
+	}
+	fprintf(f, "\n]}\n");
+	if (fclose(f) != 0) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+#else
+
+int msw_trace_dump(const char *path)
+{
+	(void)path;
+	fprintf(stderr, "error: tracing isn't built in (make TRACE=1)\n");
+	return -1;
+}
+
+#endif /* MSW_TRACE */
+
+static const char *msw_trace_path;
+
+static void msw_trace_dump_path(void)
+{
+	msw_trace_dump(msw_trace_path);
+}
+
+/**
+ * @brief Write the trace to a file when the program exits, however it exits.
+ *
+ * Calling it again changes the file rather than writing a second one.
+ */
+void msw_trace_dump_at_exit(const char *path)
+{
+	if (msw_trace_path == NULL)
+		atexit(msw_trace_dump_path);
+	msw_trace_path = path;
+}
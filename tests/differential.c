@@ -0,0 +1,360 @@
+/***************************************************************************//**
+
+  @file         differential.c
+
+  @author       Stephen Brennan
+
+  @date         Sunday, 18 October 2026
+
+  @brief        Checks that the engine's fast paths match its plain ones.
+
+  Some hot paths have a second implementation which exists only to be faster.
+  Each check here plays the same seeded games both ways, and after every move
+  compares what came out: the statuses, the visible boards, the flag counts,
+  the hashes and the undo logs, or whatever else the path computes:
+
+  - flood: giant openings uncovered on one thread, and on four (see flood.c).
+  - scan: checking for a win, counting cells and comparing boards with each
+    SIMD kernel the processor has, and with plain C (see scan.c).
+  - generic: playing beginner, intermediate and expert boards, by hand and by
+    the AI, with the engine compiled for their size and with the one for any
+    size (see msw_set_generic()).
+
+  `make check` runs every check.  The program prints a line per check and
+  exits nonzero if anything differed.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minesweeper.h"
+
+/* Differences reported before a check gives up on printing them. */
+#define CHECK_REPORT 10
+
+/* Differing cells compared between the scan kernels. */
+#define CHECK_DIFF_CELLS 64
+
+struct check {
+	const char *name;
+	void (*run)(struct check *ch);
+	long games, moves, differences;
+	long move; /* of the current game */
+};
+
+/*
+ * Splitmix64, for choosing the moves.
+ */
+static uint64_t check_rand(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static void check_fail(struct check *ch, const char *what)
+{
+	if (ch->differences++ < CHECK_REPORT)
+		fprintf(stderr, "%s: game %ld, move %ld: %s differ\n",
+		        ch->name, ch->games, ch->move, what);
+}
+
+/*
+ * Compare two games which should have come out the same, down to their undo
+ * logs.
+ */
+static void check_same(struct check *ch, msw *a, msw *b)
+{
+	const struct msw_undo_entry *x, *y;
+	int i;
+
+	if (memcmp(a->cells, b->cells, (size_t)a->rows * a->columns) != 0)
+		check_fail(ch, "boards");
+	if (a->flags != b->flags)
+		check_fail(ch, "flag counts");
+	if (a->hash != b->hash)
+		check_fail(ch, "hashes");
+	if ((a->undo == NULL) != (b->undo == NULL))
+		check_fail(ch, "undo logs");
+	if (a->undo == NULL || b->undo == NULL)
+		return;
+	if (a->gen != b->gen || a->undocap != b->undocap ||
+	    a->undoidx != b->undoidx || a->undoend != b->undoend) {
+		check_fail(ch, "undo positions");
+		return;
+	}
+	for (i = 0; i < a->undocap; i++) {
+		x = &a->undo[i];
+		y = &b->undo[i];
+		if (x->loc.row != y->loc.row || x->loc.col != y->loc.col ||
+		    x->gen != y->gen || x->old != y->old || x->new != y->new) {
+			check_fail(ch, "undo entries");
+			return;
+		}
+	}
+}
+
+/*
+ * Make a random move in both games: mostly digs, some flags, unflags and
+ * reveals, and now and then an undo or a redo.
+ */
+static void check_move(struct check *ch, msw *a, msw *b, uint64_t *rng)
+{
+	uint64_t x = check_rand(rng);
+	int r = (x >> 8) % a->rows, c = (x >> 32) % a->columns, ra, rb;
+
+	switch (x & 15) {
+	case 0:
+		ra = msw_undo(a);
+		rb = msw_undo(b);
+		break;
+	case 1:
+		ra = msw_redo(a);
+		rb = msw_redo(b);
+		break;
+	case 2: case 3:
+		ra = msw_flag(a, r, c);
+		rb = msw_flag(b, r, c);
+		break;
+	case 4:
+		ra = msw_unflag(a, r, c);
+		rb = msw_unflag(b, r, c);
+		break;
+	case 5:
+		ra = msw_reveal(a, r, c);
+		rb = msw_reveal(b, r, c);
+		break;
+	default:
+		ra = msw_dig(a, r, c);
+		rb = msw_dig(b, r, c);
+		break;
+	}
+	if (ra != rb)
+		check_fail(ch, "statuses");
+	msw_end_turn(a);
+	msw_end_turn(b);
+	check_same(ch, a, b);
+	ch->moves++;
+	ch->move++;
+}
+
+/*
+ * Uncover giant openings on one thread and on four. The boards are sparse
+ * enough that nearly every dig lands in an opening big enough to split, and
+ * flags placed before the first dig sit inside it. Half the games keep an
+ * undo log shorter than an opening, which drops its oldest entries.
+ */
+static void check_flood(struct check *ch)
+{
+	const int R = 512, C = 512, M = R * C / 100;
+	uint64_t seed, rng;
+	msw a, b;
+	int i, cap;
+
+	for (seed = 1; seed <= 6; seed++) {
+		cap = seed % 2 ? 1000 : R * C + 16;
+		msw_init(&a, R, C, M);
+		msw_init(&b, R, C, M);
+		msw_set_seed(&a, seed);
+		msw_set_seed(&b, seed);
+		msw_enable_undo_logging(&a, cap);
+		msw_enable_undo_logging(&b, cap);
+		msw_set_flood_threads(&a, 1);
+		msw_set_flood_threads(&b, 4);
+		rng = seed;
+		ch->move = 0;
+		for (i = 0; i < 64; i++) {
+			msw_flag(&a, R / 2 + i / 8, C / 2 + i % 8 + 1);
+			msw_flag(&b, R / 2 + i / 8, C / 2 + i % 8 + 1);
+		}
+		msw_dig(&a, R / 2, C / 2);
+		msw_dig(&b, R / 2, C / 2);
+		msw_end_turn(&a);
+		msw_end_turn(&b);
+		check_same(ch, &a, &b);
+		for (i = 0; i < 24; i++)
+			check_move(ch, &a, &b, &rng);
+		msw_destroy(&a);
+		msw_destroy(&b);
+		ch->games++;
+	}
+}
+
+/*
+ * Scan a pair of games with every kernel, comparing each with plain C. Game b
+ * lags behind a, so that the boards differ.
+ */
+static void check_scan_with(struct check *ch, msw *a, msw *b, int best)
+{
+	int cells[CHECK_DIFF_CELLS], want[CHECK_DIFF_CELLS], won, level;
+	struct msw_counts counts, got;
+	long ndiff, n;
+
+	msw_simd_select(MSW_SIMD_SCALAR);
+	won = msw_scan_won(a);
+	msw_count(a, &counts);
+	ndiff = msw_diff(a, b, want, CHECK_DIFF_CELLS);
+	for (level = MSW_SIMD_SCALAR + 1; level <= best; level++) {
+		msw_simd_select(level);
+		if (msw_scan_won(a) != won)
+			check_fail(ch, "wins");
+		msw_count(a, &got);
+		if (got.revealed != counts.revealed ||
+		    got.flagged != counts.flagged ||
+		    got.unknown != counts.unknown)
+			check_fail(ch, "counts");
+		n = msw_diff(a, b, cells, CHECK_DIFF_CELLS);
+		if (n != ndiff ||
+		    memcmp(cells, want, (n < CHECK_DIFF_CELLS ? n :
+		                         CHECK_DIFF_CELLS) * sizeof(int)) != 0)
+			check_fail(ch, "diffs");
+	}
+	ch->moves++;
+	ch->move++;
+}
+
+/*
+ * Compare the scan kernels on boards of many shapes, so that every length of
+ * leftover cells comes up, as games go on: random digs and flags (some of
+ * them into mines), and then every clear cell dug, which wins unless a mine
+ * went off.
+ */
+static void check_scan(struct check *ch)
+{
+	int best = msw_simd_select(-1), R, C, M, i, r, c;
+	uint64_t seed, rng, x;
+	msw a, b;
+
+	for (seed = 1; seed <= 64; seed++) {
+		rng = seed;
+		x = check_rand(&rng);
+		R = seed == 64 ? 256 : 1 + x % 40;
+		C = seed == 64 ? 257 : 2 + (x >> 16) % 70;
+		M = 1 + (x >> 32) % (R * C / 4 + 1);
+		msw_init(&a, R, C, M);
+		msw_init(&b, R, C, M);
+		msw_set_seed(&a, seed);
+		msw_set_seed(&b, seed);
+		ch->move = 0;
+		check_scan_with(ch, &a, &b, best);
+		msw_dig(&a, R / 2, C / 2);
+		msw_dig(&b, R / 2, C / 2);
+		for (i = 0; i < 32; i++) {
+			x = check_rand(&rng);
+			r = (x >> 8) % R;
+			c = (x >> 32) % C;
+			if (x & 3)
+				msw_dig(&a, r, c);
+			else
+				msw_flag(&a, r, c);
+			if (i % 2 && x & 3)
+				msw_dig(&b, r, c);
+			check_scan_with(ch, &a, &b, best);
+		}
+		for (i = 0; i < R * C; i++)
+			if (MSW_CELL_GRID(a.cells[i]) != MSW_CMINE)
+				msw_dig(&a, i / C, i % C);
+		check_scan_with(ch, &a, &b, best);
+		msw_destroy(&a);
+		msw_destroy(&b);
+		ch->games++;
+	}
+	msw_simd_select(-1);
+}
+
+/*
+ * Let the AI make a move in both games, or a random move when it is stumped.
+ */
+static void check_ai(struct check *ch, msw *a, msw *b, uint64_t *rng)
+{
+	struct msw_ai_move x = msw_ai(a), y = msw_ai(b);
+
+	if (x.action != y.action || x.loc.row != y.loc.row ||
+	    x.loc.col != y.loc.col || strcmp(x.description, y.description)) {
+		check_fail(ch, "AI moves");
+		return;
+	}
+	if (x.action == AI_NONE) {
+		check_move(ch, a, b, rng);
+		return;
+	}
+	if (msw_ai_apply(a, x) != msw_ai_apply(b, y))
+		check_fail(ch, "statuses");
+	msw_end_turn(a);
+	msw_end_turn(b);
+	check_same(ch, a, b);
+	ch->moves++;
+	ch->move++;
+}
+
+/*
+ * Play the standard boards, which have engines compiled for their size, with
+ * the generic engine as well: mostly AI moves, which read the numbers through
+ * the engine, and some random ones. Half the games keep an undo log.
+ */
+static void check_generic(struct check *ch)
+{
+	static const int sizes[][3] = {
+		{ 9, 9, 10 }, { 16, 16, 40 }, { 16, 30, 99 },
+	};
+	uint64_t seed, rng, x;
+	int s, i, R, C;
+	msw a, b;
+
+	for (s = 0; s < 3; s++) {
+		R = sizes[s][0];
+		C = sizes[s][1];
+		for (seed = 1; seed <= 100; seed++) {
+			msw_init(&a, R, C, sizes[s][2]);
+			msw_init(&b, R, C, sizes[s][2]);
+			msw_set_seed(&a, seed);
+			msw_set_seed(&b, seed);
+			msw_set_generic(&b, 1);
+			if (seed % 2) {
+				msw_enable_undo_logging(&a, 64);
+				msw_enable_undo_logging(&b, 64);
+			}
+			rng = seed;
+			ch->move = 0;
+			x = check_rand(&rng);
+			msw_dig(&a, (x >> 8) % R, (x >> 32) % C);
+			msw_dig(&b, (x >> 8) % R, (x >> 32) % C);
+			if (msw_3bv(&a) != msw_3bv(&b))
+				check_fail(ch, "3BVs");
+			for (i = 0; i < 100; i++) {
+				if (check_rand(&rng) % 4)
+					check_ai(ch, &a, &b, &rng);
+				else
+					check_move(ch, &a, &b, &rng);
+			}
+			msw_destroy(&a);
+			msw_destroy(&b);
+			ch->games++;
+		}
+	}
+}
+
+int main(void)
+{
+	struct check checks[] = {
+		{ .name = "flood", .run = check_flood },
+		{ .name = "scan", .run = check_scan },
+		{ .name = "generic", .run = check_generic },
+	};
+	int i, n = sizeof(checks) / sizeof(checks[0]), failed = 0;
+
+	for (i = 0; i < n; i++) {
+		checks[i].run(&checks[i]);
+		printf("%s: %ld games, %ld moves, %ld differences\n",
+		       checks[i].name, checks[i].games, checks[i].moves,
+		       checks[i].differences);
+		failed |= checks[i].differences != 0;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}